@@ -1,23 +1,45 @@
 // Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
 // SPDX-License-Identifier: BSD-3-Clause
 
-#include "clang/AST/RecursiveASTVisitor.h"
-#include "clang/Basic/Diagnostic.h"
+#include "idt/client_usage.hh"
+#include "idt/file_cache.hh"
+#include "idt/file_watcher.hh"
+#include "idt/idt.hh"
+#include "idt/incremental.hh"
+#include "idt/link_log.hh"
+#include "idt/prefetch.hh"
+#include "idt/reproducer.hh"
+
+#include "clang/Basic/DiagnosticOptions.h"
 #include "clang/Frontend/CompilerInstance.h"
-#include "clang/Lex/PPCallbacks.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Lex/Preprocessor.h"
-#include "clang/Rewrite/Frontend/FixItRewriter.h"
+#include "clang/Serialization/ASTReader.h"
+#include "clang/Serialization/ModuleFile.h"
 #include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/JSONCompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
-#include "llvm/ADT/SmallPtrSet.h"
-
-#include <algorithm>
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CrashRecoveryContext.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/GlobPattern.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
-#include <iostream>
+#include <map>
 #include <optional>
+#include <set>
 #include <string>
-#include <tuple>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
 namespace idt {
@@ -25,19 +47,10 @@ llvm::cl::OptionCategory category{"interface definition scanner options"};
 }
 
 namespace {
-// TODO(compnerd) make this configurable via a configuration file or commandline
-const std::set<std::string> kIgnoredBuiltins{
-  "_BitScanForward",
-  "_BitScanForward64",
-  "_BitScanReverse",
-  "_BitScanReverse64",
-  "__builtin_strlen",
-};
-
 llvm::cl::opt<std::string>
 export_macro("export-macro",
              llvm::cl::desc("The macro to decorate interfaces with"),
-             llvm::cl::value_desc("define"), llvm::cl::Required,
+             llvm::cl::value_desc("define"),
              llvm::cl::cat(idt::category));
 
 llvm::cl::opt<std::string>
@@ -46,6 +59,13 @@ include_header("include-header",
                llvm::cl::value_desc("header"),
                llvm::cl::cat(idt::category));
 
+llvm::cl::list<std::string>
+components("component",
+           llvm::cl::desc("Annotate the headers matching the path prefix or "
+                          "glob with the macro, and add the header for it"),
+           llvm::cl::value_desc("pattern=define[,header]"),
+           llvm::cl::cat(idt::category));
+
 llvm::cl::opt<bool>
 apply_fixits("apply-fixits", llvm::cl::init(false),
              llvm::cl::desc("Apply suggested changes to decorate interfaces"),
@@ -63,618 +83,1398 @@ ignored_symbols("ignore",
                 llvm::cl::CommaSeparated,
                 llvm::cl::cat(idt::category));
 
-template <typename Key, typename Compare, typename Allocator>
-bool contains(const std::set<Key, Compare, Allocator>& set, const Key& key) {
-  return set.find(key) != set.end();
-}
+llvm::cl::list<std::string>
+header_extensions("header-extensions",
+                  llvm::cl::desc("The extensions of the files which are "
+                                 "considered headers (default: h,hh,hpp,hxx)"),
+                  llvm::cl::value_desc("extension[,extension...]"),
+                  llvm::cl::CommaSeparated,
+                  llvm::cl::cat(idt::category));
 
-const std::set<std::string> &get_ignored_symbols() {
-  static auto kIgnoredFunctions = [&]() -> std::set<std::string> {
-      return { ignored_symbols.begin(), ignored_symbols.end() };
-    }();
+llvm::cl::opt<std::string>
+header_filter("header-filter",
+              llvm::cl::desc("Only annotate the headers matching the pattern"),
+              llvm::cl::value_desc("regex"),
+              llvm::cl::cat(idt::category));
 
-  return kIgnoredFunctions;
-}
+llvm::cl::opt<bool>
+over_exports("over-exports", llvm::cl::init(false),
+             llvm::cl::desc("Report exported declarations which are not part "
+                            "of the public interface"),
+             llvm::cl::cat(idt::category));
 
-}
+llvm::cl::list<std::string>
+private_headers("private-header",
+                llvm::cl::desc("Headers which are not part of the public "
+                               "interface"),
+                llvm::cl::value_desc("regex"),
+                llvm::cl::cat(idt::category));
 
-namespace idt {
-struct PPCallbacks : clang::PPCallbacks {
-  // Describes the source location of an #include statement and the name of the
-  // file being included.
-  using IncludeLocation = std::tuple<std::string, clang::SourceLocation>;
-
-  // Maps the name of a source file to list of include statements its contains
-  // in the order they are discovered int he file.
-  using FileIncludes =
-      std::unordered_map<std::string, std::vector<IncludeLocation>>;
-
-  PPCallbacks(clang::SourceManager &source_manager, FileIncludes &file_includes)
-      : source_manager_(source_manager), file_includes_(file_includes) {}
-
-  void
-  InclusionDirective(clang::SourceLocation HashLoc,
-                     const clang::Token &IncludeTok, clang::StringRef FileName,
-                     bool IsAngled, clang::CharSourceRange FilenameRange,
-                     clang::OptionalFileEntryRef File,
-                     clang::StringRef SearchPath, clang::StringRef RelativePath,
-                     const clang::Module *SuggestedModule, bool ModuleImported,
-                     clang::SrcMgr::CharacteristicKind FileType) override {
-    // Only track #include statements not #import statements.
-    if (ModuleImported)
-      return;
+llvm::cl::list<std::string>
+internal_namespaces("internal-namespace",
+                    llvm::cl::desc("Namespaces which contain implementation "
+                                   "details (default: detail,details,impl,"
+                                   "internal)"),
+                    llvm::cl::value_desc("namespace[,namespace...]"),
+                    llvm::cl::CommaSeparated,
+                    llvm::cl::cat(idt::category));
 
-    // Track the name and location of each include in the order discovered.
-    clang::SourceLocation SLoc = source_manager_.getSpellingLoc(HashLoc);
+llvm::cl::opt<bool>
+export_report("export-report", llvm::cl::init(false),
+              llvm::cl::desc("Report the estimated number of exported "
+                             "symbols"),
+              llvm::cl::cat(idt::category));
+
+llvm::cl::opt<unsigned>
+export_budget("export-budget", llvm::cl::init(65535),
+              llvm::cl::desc("The maximum number of exported symbols "
+                             "(default: 65535)"),
+              llvm::cl::value_desc("symbols"),
+              llvm::cl::cat(idt::category));
+
+llvm::cl::opt<unsigned>
+export_report_limit("export-report-limit", llvm::cl::init(10),
+                    llvm::cl::desc("The number of entries listed in each "
+                                   "section of the export report "
+                                   "(default: 10)"),
+                    llvm::cl::value_desc("entries"),
+                    llvm::cl::cat(idt::category));
 
-    // Get the name of the file that contains the #include statement. This
-    // string is distinct from the FileName function parameter, which is the
-    // name of the include target (e.g. #include <FileName>).
-    std::string containingFileName = source_manager_.getFilename(SLoc).str();
+llvm::cl::opt<bool>
+extern_templates("extern-templates", llvm::cl::init(false),
+                 llvm::cl::desc("Report the class template specializations "
+                                "instantiated by the most translation units"),
+                 llvm::cl::cat(idt::category));
 
-    // Only add the include to the list if it isn't already present.
-    auto &includes = file_includes_[containingFileName];
-    if (std::none_of(includes.begin(), includes.end(),
-                     [&FileName](const IncludeLocation &include) {
-                       return std::get<0>(include) == FileName.str();
-                     }))
-      includes.emplace_back(FileName.str(), SLoc);
-  }
+llvm::cl::opt<std::string>
+extern_template_macro("extern-template-macro",
+                      llvm::cl::desc("The macro to decorate explicit template "
+                                     "instantiations with"),
+                      llvm::cl::value_desc("define"),
+                      llvm::cl::cat(idt::category));
+
+llvm::cl::opt<unsigned>
+extern_template_threshold("extern-template-threshold", llvm::cl::init(2),
+                          llvm::cl::desc("The minimum number of translation "
+                                         "units instantiating a "
+                                         "specialization (default: 2)"),
+                          llvm::cl::value_desc("translation-units"),
+                          llvm::cl::cat(idt::category));
+
+llvm::cl::opt<unsigned>
+extern_template_limit("extern-template-limit", llvm::cl::init(10),
+                      llvm::cl::desc("The number of specializations reported "
+                                     "(default: 10)"),
+                      llvm::cl::value_desc("specializations"),
+                      llvm::cl::cat(idt::category));
 
-private:
-  clang::SourceManager &source_manager_;
-  FileIncludes &file_includes_;
-};
+llvm::cl::opt<bool>
+profile_headers("profile-headers", llvm::cl::init(false),
+                llvm::cl::desc("Report the time spent processing each header"),
+                llvm::cl::cat(idt::category));
 
-// Track a set of clang::Decl declarations by unique ID.
-class DeclSet {
-  llvm::SmallPtrSet<std::uintptr_t, 32> decls_;
+llvm::cl::opt<unsigned>
+profile_headers_limit("profile-headers-limit", llvm::cl::init(20),
+                      llvm::cl::desc("The number of headers reported "
+                                     "(default: 20)"),
+                      llvm::cl::value_desc("headers"),
+                      llvm::cl::cat(idt::category));
 
-  // Use pointer identity of the canonical declaration object as a unique ID.
-  template <typename Decl_>
-  std::uintptr_t decl_id(const Decl_ *D) const {
-    return reinterpret_cast<std::uintptr_t>(D->getCanonicalDecl());
-  }
+llvm::cl::opt<std::string>
+profile_trace("profile-trace",
+              llvm::cl::desc("Write a Chrome trace of the run to <file>"),
+              llvm::cl::value_desc("file"),
+              llvm::cl::cat(idt::category));
 
-public:
-  template <typename Decl_>
-  inline void insert(const Decl_ *D) {
-    decls_.insert(decl_id(D));
-  }
+llvm::cl::opt<std::string>
+symbol_file("symbol-file",
+            llvm::cl::desc("Write the symbols to export to <file> rather than "
+                           "annotating the declarations"),
+            llvm::cl::value_desc("file"),
+            llvm::cl::cat(idt::category));
+
+llvm::cl::opt<idt::symbol_file_format>
+symbol_file_format("symbol-file-format",
+                   llvm::cl::desc("The format of the symbol file (default: "
+                                  "based on the extension of the file)"),
+                   llvm::cl::values(
+                       clEnumValN(idt::symbol_file_format::version_script,
+                                  "version-script", "ELF version script"),
+                       clEnumValN(idt::symbol_file_format::exported_symbols_list,
+                                  "exported-symbols-list",
+                                  "Mach-O exported symbols list"),
+                       clEnumValN(idt::symbol_file_format::module_definition,
+                                  "def", "Windows module definition file")),
+                   llvm::cl::cat(idt::category));
 
-  template <typename Decl_>
-  inline bool contains(const Decl_ *D) const {
-    return decls_.find(decl_id(D)) != decls_.end();
-  }
-};
+llvm::cl::opt<bool>
+stats("stats", llvm::cl::init(false),
+      llvm::cl::desc("Report the statistics of the analysis"),
+      llvm::cl::cat(idt::category));
 
-class visitor : public clang::RecursiveASTVisitor<visitor> {
-  clang::ASTContext &context_;
-  clang::SourceManager &source_manager_;
-  std::optional<unsigned> id_unexported_;
-  std::optional<unsigned> id_exported_;
-  PPCallbacks::FileIncludes &file_includes_;
+llvm::cl::opt<std::string>
+snapshot("snapshot",
+         llvm::cl::desc("Write a snapshot of the public interface to <file>"),
+         llvm::cl::value_desc("file"),
+         llvm::cl::cat(idt::category));
 
-  // Accumulates the set of declarations that have been marked for export by
-  // this visitor.
-  DeclSet exported_decls_;
+llvm::cl::opt<std::string>
+findings("findings",
+         llvm::cl::desc("Write the findings of the run, ordered by their "
+                        "location, to <file>"),
+         llvm::cl::value_desc("file"),
+         llvm::cl::cat(idt::category));
+
+// This is handled before the command line is parsed, as comparing snapshots
+// does not require a compilation database or the export macro. It is declared
+// so that it is listed by --help.
+llvm::cl::opt<bool>
+diff_snapshot("diff-snapshot", llvm::cl::init(false),
+              llvm::cl::desc("Compare the snapshots <before> and <after>, "
+                             "given as the only arguments"),
+              llvm::cl::cat(idt::category));
 
-  void add_missing_include(clang::SourceLocation location) {
-    if (include_header.empty())
-      return;
+llvm::cl::opt<std::string>
+export_index("export-index",
+             llvm::cl::desc("Record the declarations decided to be exported "
+                            "in <file>, and skip those recorded by earlier "
+                            "runs"),
+             llvm::cl::value_desc("file"),
+             llvm::cl::cat(idt::category));
 
-    clang::DiagnosticsEngine &diagnostics_engine = context_.getDiagnostics();
+llvm::cl::list<std::string>
+configurations("configuration",
+               llvm::cl::desc("Analyze the sources with the extra compiler "
+                              "arguments; several configurations are "
+                              "analyzed in parallel and their changes merged"),
+               llvm::cl::value_desc("arguments"),
+               llvm::cl::cat(idt::category));
 
-    static unsigned kID = diagnostics_engine.getCustomDiagID(
-        clang::DiagnosticsEngine::Remark, "missing include statement %0");
+llvm::cl::opt<std::string>
+explain("explain",
+        llvm::cl::desc("Explain the decisions about the declarations with the "
+                       "qualified name"),
+        llvm::cl::value_desc("qualified-name"),
+        llvm::cl::cat(idt::category));
 
-    clang::SourceLocation spellingLoc =
-        source_manager_.getSpellingLoc(location);
-    const std::string fileName = source_manager_.getFilename(spellingLoc).str();
-    auto &includes = file_includes_[fileName];
+llvm::cl::opt<std::string>
+from_link_log("from-link-log",
+              llvm::cl::desc("Only annotate the symbols reported as undefined "
+                             "in the log of a failed link"),
+              llvm::cl::value_desc("file"),
+              llvm::cl::cat(idt::category));
 
-    // TODO: if the modified file contains no existing include directives, we
-    // cannot currently determine where to insert the required include.
-    if (includes.empty())
-      return;
+llvm::cl::opt<std::string>
+from_clients("from-clients",
+             llvm::cl::desc("Only annotate the declarations referenced by the "
+                            "sources of the compilation database in <dir>"),
+             llvm::cl::value_desc("dir"),
+             llvm::cl::cat(idt::category));
 
-    // Determine if the header is already included.
-    if (std::any_of(includes.begin(), includes.end(),
-                    [](const PPCallbacks::IncludeLocation &include) {
-                      return std::get<0>(include) == include_header;
-                    }))
-      return;
+llvm::cl::opt<std::string>
+module_cache_path("module-cache-path",
+                  llvm::cl::desc("Analyze the sources with Clang modules, "
+                                 "building the modules of the project once "
+                                 "into <dir>"),
+                  llvm::cl::value_desc("dir"),
+                  llvm::cl::cat(idt::category));
+
+llvm::cl::opt<std::string>
+capture("capture",
+        llvm::cl::desc("Record the files read by the analysis of the source, "
+                       "its compile commands and the options in <dir>"),
+        llvm::cl::value_desc("dir"),
+        llvm::cl::cat(idt::category));
 
-    // Insert the new include at the start of the existing include list. Rely
-    // on clang-format to properly sort the include statements in alphabetical
-    // order.
-    clang::SourceLocation insertLoc =
-        source_manager_.getSpellingLoc(std::get<1>(includes.front()));
+llvm::cl::opt<std::string>
+replay("replay",
+       llvm::cl::desc("Replay the analysis recorded in <dir> by --capture "
+                      "from memory"),
+       llvm::cl::value_desc("dir"),
+       llvm::cl::cat(idt::category));
+
+llvm::cl::opt<unsigned>
+tu_timeout("tu-timeout", llvm::cl::init(0),
+           llvm::cl::desc("Abandon the analysis of a source after <seconds> "
+                          "and continue with the rest (default: no limit)"),
+           llvm::cl::value_desc("seconds"),
+           llvm::cl::cat(idt::category));
 
-    // Emit the fix-it hint to add the include statement.
-    // TODO: consider using std::format after moving to C++20
-    std::string FixText = "#include \"" + include_header + "\"\n";
-    clang::FixItHint FixIt =
-        clang::FixItHint::CreateInsertion(insertLoc, FixText);
-    diagnostics_engine.Report(insertLoc, kID) << include_header << FixIt;
+llvm::cl::opt<bool>
+prefetch("prefetch", llvm::cl::init(false),
+         llvm::cl::desc("Read the files of the next source on a background "
+                        "thread while the current source is analyzed"),
+         llvm::cl::cat(idt::category));
 
-    // Add the new include to our list so we don't add it again.
-    includes.insert(
-        includes.begin(),
-        std::tuple(static_cast<std::string>(include_header), insertLoc));
+llvm::cl::opt<std::string>
+incremental("incremental",
+            llvm::cl::desc("Skip the sources whose files are unchanged since "
+                           "they were recorded in <file>, and record the "
+                           "files of the sources analyzed"),
+            llvm::cl::value_desc("file"),
+            llvm::cl::cat(idt::category));
+
+llvm::cl::opt<bool>
+watch("watch", llvm::cl::init(false),
+      llvm::cl::desc("Analyze the affected sources again whenever a file "
+                     "which they read changes"),
+      llvm::cl::cat(idt::category));
+
+idt::options get_options() {
+  idt::options options;
+  options.export_macro = export_macro;
+  options.include_header = include_header;
+  for (llvm::StringRef component : components) {
+    auto [pattern, annotation] = component.rsplit('=');
+    auto [macro, header] = annotation.split(',');
+    options.components.push_back({pattern.str(), macro.str(), header.str()});
+  }
+  options.apply_fixits = apply_fixits;
+  options.inplace = inplace;
+  options.ignored_symbols = {ignored_symbols.begin(), ignored_symbols.end()};
+  if (!header_extensions.empty()) {
+    options.header_extensions.clear();
+    for (const auto &extension : header_extensions)
+      options.header_extensions.push_back(
+          llvm::StringRef(extension).starts_with(".") ? extension
+                                                      : "." + extension);
   }
+  options.header_filter = header_filter;
+  options.over_exports = over_exports;
+  options.private_headers = {private_headers.begin(), private_headers.end()};
+  if (!internal_namespaces.empty())
+    options.internal_namespaces = {internal_namespaces.begin(),
+                                   internal_namespaces.end()};
+  options.export_report = export_report;
+  options.export_budget = export_budget;
+  options.export_report_limit = export_report_limit;
+  options.extern_templates = extern_templates;
+  options.extern_template_macro = extern_template_macro;
+  options.extern_template_threshold = extern_template_threshold;
+  options.extern_template_limit = extern_template_limit;
+  options.profile_headers = profile_headers;
+  options.profile_headers_limit = profile_headers_limit;
+  options.snapshot = !snapshot.empty();
+  options.findings = !findings.empty();
+  options.stats = stats;
+  options.configurations = {configurations.begin(), configurations.end()};
+  options.explain = explain;
+  if (!symbol_file.empty()) {
+    if (symbol_file_format.getNumOccurrences())
+      options.symbol_file = symbol_file_format;
+    else if (llvm::sys::path::extension(symbol_file).equals_insensitive(".def"))
+      options.symbol_file = idt::symbol_file_format::module_definition;
+    else if (llvm::sys::path::extension(symbol_file) == ".exp")
+      options.symbol_file = idt::symbol_file_format::exported_symbols_list;
+    else
+      options.symbol_file = idt::symbol_file_format::version_script;
+  }
+  return options;
+}
 
-  clang::DiagnosticBuilder
-  unexported_public_interface(const clang::Decl *D) {
-    return unexported_public_interface(D, get_location(D));
+bool write_trace(llvm::StringRef path) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << "unable to write '" << path << "': " << ec.message()
+                 << "\n";
+    return false;
   }
 
-  clang::DiagnosticBuilder
-  unexported_public_interface(const clang::Decl *D, clang::SourceLocation location) {
-    add_missing_include(location);
+  if (llvm::Error error = llvm::timeTraceProfilerWrite(os)) {
+    llvm::logAllUnhandledErrors(std::move(error), llvm::errs());
+    return false;
+  }
+  return true;
+}
 
-    // Track every unexported declaration encountered. This information is used
-    // by is_symbol_exported to ensure a symbol does not get reported multiple
-    // times.
-    exported_decls_.insert(D);
+bool write_symbol_file(llvm::StringRef path, const idt::summary &summary) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << "unable to write '" << path << "': " << ec.message()
+                 << "\n";
+    return false;
+  }
 
-    clang::DiagnosticsEngine &diagnostics_engine = context_.getDiagnostics();
+  summary.write_symbol_file(os);
+  return true;
+}
 
-    if (!id_unexported_)
-      id_unexported_ =
-          diagnostics_engine.getCustomDiagID(clang::DiagnosticsEngine::Remark,
-                                             "unexported public interface %0");
+bool write_findings(llvm::StringRef path, const idt::summary &summary) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << "unable to write '" << path << "': " << ec.message()
+                 << "\n";
+    return false;
+  }
 
-    return diagnostics_engine.Report(location, *id_unexported_);
+  summary.write_findings(os);
+  return true;
+}
+
+int diff_snapshots(llvm::StringRef before, llvm::StringRef after) {
+  llvm::Expected<idt::interface_snapshot_file> lhs =
+      idt::interface_snapshot_file::open(before);
+  if (!lhs) {
+    llvm::logAllUnhandledErrors(lhs.takeError(), llvm::errs());
+    return EXIT_FAILURE;
   }
 
-  clang::DiagnosticBuilder
-  exported_private_interface(clang::SourceLocation location) {
-    clang::DiagnosticsEngine &diagnostics_engine = context_.getDiagnostics();
+  llvm::Expected<idt::interface_snapshot_file> rhs =
+      idt::interface_snapshot_file::open(after);
+  if (!rhs) {
+    llvm::logAllUnhandledErrors(rhs.takeError(), llvm::errs());
+    return EXIT_FAILURE;
+  }
 
-    if (!id_exported_)
-      id_exported_ =
-          diagnostics_engine.getCustomDiagID(clang::DiagnosticsEngine::Remark,
-                                             "exported private interface %0");
+  return idt::diff(*lhs, *rhs, llvm::outs()) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-    return diagnostics_engine.Report(location, *id_exported_);
+bool read_link_log(llvm::StringRef path, std::set<std::string> &symbols) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/true);
+  if (!buffer) {
+    llvm::errs() << "unable to read '" << path << "': "
+                 << buffer.getError().message() << "\n";
+    return false;
   }
 
-  template <typename Decl_>
-  inline clang::FullSourceLoc get_location(const Decl_ *TD) const {
-    return context_.getFullLoc(TD->getBeginLoc()).getExpansionLoc();
+  symbols = idt::parse_link_log((*buffer)->getBuffer());
+  return true;
+}
+
+clang::tooling::ArgumentsAdjuster
+get_configuration_adjuster(llvm::StringRef configuration) {
+  llvm::SmallVector<llvm::StringRef, 8> arguments;
+  llvm::SplitString(configuration, arguments);
+
+  clang::tooling::CommandLineArguments extra;
+  for (llvm::StringRef argument : arguments)
+    extra.push_back(argument.str());
+  return clang::tooling::getInsertArgumentAdjuster(
+      extra, clang::tooling::ArgumentInsertPosition::END);
+}
+
+// Analyze the sources with Clang modules, which are built from the module maps
+// of the project into `directory` once, and are loaded lazily by every source
+// which imports them rather than parsing their headers again.
+clang::tooling::ArgumentsAdjuster
+get_module_adjuster(llvm::StringRef directory) {
+  return clang::tooling::getInsertArgumentAdjuster(
+      {"-fmodules", "-fmodules-cache-path=" + directory.str()},
+      clang::tooling::ArgumentInsertPosition::END);
+}
+
+// Determine the directory given by --replay. This is needed before the command
+// line is parsed, as the reproducer provides the sources.
+std::optional<std::string>
+get_replay_directory(llvm::ArrayRef<const char *> arguments) {
+  for (std::size_t index = 1; index < arguments.size(); ++index) {
+    llvm::StringRef argument = arguments[index];
+    if (argument == "--")
+      break;
+    if (!argument.consume_front("-"))
+      continue;
+    argument.consume_front("-");
+    if (argument.consume_front("replay="))
+      return argument.str();
+    if (argument == "replay" && index + 1 < arguments.size())
+      return std::string(arguments[index + 1]);
   }
+  return std::nullopt;
+}
 
-  template <typename Decl_>
-  bool is_in_header(const Decl_ *D) const {
-    const clang::FullSourceLoc location = get_location(D);
-  const clang::FileID id = source_manager_.getFileID(location);
-  if (const auto entry = source_manager_.getFileEntryRefForID(id)) {
-    const llvm::StringRef name = entry->getName();
-    for (const auto &extension : {".h", ".hh", ".hpp", ".hxx"})
-      if (name.ends_with(extension))
-        return true;
-    }
-    return false;
+// Add the reporting options of the command line to the options recorded by a
+// reproducer, so that a replay can be profiled or explained.
+void add_reporting_options(idt::options &options,
+                           const idt::options &reporting) {
+  options.over_exports |= reporting.over_exports;
+  options.export_report |= reporting.export_report;
+  options.extern_templates |= reporting.extern_templates;
+  options.profile_headers |= reporting.profile_headers;
+  options.snapshot |= reporting.snapshot;
+  options.stats |= reporting.stats;
+  if (reporting.symbol_file != idt::symbol_file_format::none)
+    options.symbol_file = reporting.symbol_file;
+  if (!reporting.explain.empty())
+    options.explain = reporting.explain;
+}
+
+// Determine the compile commands of a captured source as they are run, so that
+// the replay depends on neither the configuration nor the location of the
+// resource directory of the installation which captured it.
+std::vector<clang::tooling::CompileCommand>
+get_capture_commands(const clang::tooling::CompilationDatabase &compilations,
+                     llvm::StringRef source, const idt::options &options,
+                     const char *argv0) {
+  // Any address within the executable locates it.
+  static char anchor;
+  const std::string resource_directory =
+      "-resource-dir=" +
+      clang::CompilerInvocation::GetResourcesPath(argv0, &anchor);
+
+  std::vector<clang::tooling::CompileCommand> commands =
+      compilations.getCompileCommands(source);
+  for (clang::tooling::CompileCommand &command : commands) {
+    llvm::SmallString<256> directory{command.Directory};
+    llvm::sys::fs::make_absolute(directory);
+    llvm::sys::path::remove_dots(directory, /*remove_dot_dot=*/true);
+    command.Directory = std::string(directory);
+
+    if (!options.configurations.empty())
+      command.CommandLine = get_configuration_adjuster(
+          options.configurations.front())(command.CommandLine,
+                                          command.Filename);
+
+    if (llvm::none_of(command.CommandLine, [](llvm::StringRef argument) {
+          return argument.starts_with("-resource-dir");
+        }))
+      command.CommandLine = clang::tooling::getInsertArgumentAdjuster(
+          resource_directory.c_str())(command.CommandLine, command.Filename);
   }
+  return commands;
+}
 
-  template <typename Decl_>
-  inline bool is_in_system_header(const Decl_ *D) const {
-    return source_manager_.isInSystemHeader(get_location(D));
+// Determine the digest of the compile commands of a source and of the other
+// arguments of the run, so that the source is analyzed again if either
+// changes.
+std::uint64_t
+get_command_digest(const clang::tooling::CompilationDatabase &compilations,
+                   llvm::StringRef source, llvm::StringRef arguments) {
+  std::string command{arguments};
+  for (const clang::tooling::CompileCommand &entry :
+       compilations.getCompileCommands(source)) {
+    command += '\0';
+    command += entry.Directory;
+    for (const std::string &argument : entry.CommandLine) {
+      command += '\0';
+      command += argument;
+    }
   }
+  return idt::get_digest(command);
+}
 
-  template <typename Decl_>
-  bool is_symbol_exported(const Decl_ *D) const {
-    // Check the set of symbols we've already marked for export.
-    if (exported_decls_.contains(D))
-      return true;
+// Determine the absolute path of a source, which identifies it in the
+// incremental record.
+std::string get_absolute_path(llvm::StringRef source) {
+  llvm::SmallString<256> path{source};
+  llvm::sys::fs::make_absolute(path);
+  llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+  return std::string(path);
+}
 
-    // Check if the symbol is annotated with __declspec(dllimport) or
-    // __declspec(dllexport).
-    if (D->template hasAttr<clang::DLLExportAttr>() ||
-        D->template hasAttr<clang::DLLImportAttr>())
-      return true;
+// Whether the files read by each source are recorded, for --incremental or
+// --watch.
+bool records_dependencies() { return !incremental.empty() || watch; }
 
-    // Check if the symbol is annotated with [[gnu::visibility("default")]]
-    // or the equivalent __attribute__((visibility("default")))
-    if (const auto *VA = D->template getAttr<clang::VisibilityAttr>())
-      return VA->getVisibility() == clang::VisibilityAttr::VisibilityType::Default;
+bool validate_options(const idt::options &options) {
+  if (options.export_macro.empty() && options.components.empty()) {
+    llvm::errs() << "either --export-macro or --component must be provided\n";
+    return false;
+  }
 
-    if (llvm::isa<clang::RecordDecl>(D))
+  for (const auto &component : options.components) {
+    if (component.pattern.empty() || component.export_macro.empty()) {
+      llvm::errs() << "invalid --component '" << component.pattern << '='
+                   << component.export_macro
+                   << "': expected <pattern>=<define>[,<header>]\n";
       return false;
+    }
 
-    // For non-record declarations, the DeclContext is the containing record.
-    for (const clang::DeclContext *DC = D->getDeclContext(); DC; DC = DC->getParent())
-      if (const auto *RD = llvm::dyn_cast<clang::RecordDecl>(DC))
-        return is_symbol_exported(RD);
+    if (!idt::is_glob(component.pattern))
+      continue;
+    if (auto glob = llvm::GlobPattern::create(component.pattern); !glob) {
+      llvm::errs() << "invalid --component pattern '" << component.pattern
+                   << "': " << llvm::toString(glob.takeError()) << "\n";
+      return false;
+    }
+  }
 
+  for (const auto &pattern : options.private_headers) {
+    std::string error;
+    if (!llvm::Regex(pattern).isValid(error)) {
+      llvm::errs() << "invalid --private-header pattern '" << pattern
+                   << "': " << error << "\n";
+      return false;
+    }
+  }
+
+  std::string error;
+  if (!options.header_filter.empty() &&
+      !llvm::Regex(options.header_filter).isValid(error)) {
+    llvm::errs() << "invalid --header-filter pattern '"
+                 << options.header_filter << "': " << error << "\n";
     return false;
   }
 
-  // Determine if a function needs exporting and add the export annotation as
-  // required.
-  void export_function_if_needed(const clang::FunctionDecl *FD) {
-    // Check if the symbol is already exported.
-    if (is_symbol_exported(FD))
-      return;
+  // The prefetched files are read from memory for the rest of the run, so the
+  // sources after the first would not see the changes applied to them.
+  if (prefetch && options.apply_fixits) {
+    llvm::errs() << "--prefetch cannot be used with --apply-fixits\n";
+    return false;
+  }
+  return true;
+}
+}
 
-    // Ignore declarations from the system.
-    if (is_in_system_header(FD))
-      return;
+namespace idt {
+// The code with which the analysis of a source which runs past --tu-timeout is
+// abandoned, as with timeout(1).
+constexpr int kTimedOut = 124;
+
+// Abandons the analysis of a source once it runs past its deadline. The
+// deadline is checked on the thread analyzing the source as each file is
+// entered, as each declaration is parsed or instantiated, and as the analysis
+// visits each declaration, where no locks are held, and the analysis is
+// unwound by the crash recovery context running it.
+class watchdog {
+  std::chrono::steady_clock::time_point deadline_;
 
-    // Skip declarations not in header files.
-    if (!is_in_header(FD))
-      return;
+public:
+  explicit watchdog(std::chrono::seconds timeout)
+      : deadline_(std::chrono::steady_clock::now() + timeout) {}
 
-    // We are only interested in non-dependent types.
-    if (FD->isDependentContext())
+  void check() const {
+    if (std::chrono::steady_clock::now() < deadline_)
       return;
+    if (llvm::CrashRecoveryContext *context =
+            llvm::CrashRecoveryContext::GetCurrent())
+      context->HandleExit(kTimedOut);
+  }
+};
 
-    // If the function has a body, it can be materialized by the user.
-    if (FD->hasBody())
-      return;
+struct watchdog_callbacks : clang::PPCallbacks {
+  explicit watchdog_callbacks(const watchdog &watchdog) : watchdog_(watchdog) {}
 
-    // Skip methods in template declarations.
-    if (FD->getTemplateInstantiationPattern())
-      return;
+  void FileChanged(clang::SourceLocation, FileChangeReason,
+                   clang::SrcMgr::CharacteristicKind,
+                   clang::FileID) override {
+    watchdog_.check();
+  }
 
-    // Ignore friend declarations.
-    if (FD->getFriendObjectKind() != clang::Decl::FOK_None)
-      return;
+private:
+  const watchdog &watchdog_;
+};
 
-    // Ignore deleted and defaulted functions (e.g. operators).
-    if (FD->isDeleted() || FD->isDefaulted())
-      return;
+struct watchdog_consumer : clang::ASTConsumer {
+  explicit watchdog_consumer(const watchdog &watchdog) : watchdog_(watchdog) {}
 
-    // Skip template class template argument deductions.
-    if (llvm::isa<clang::CXXDeductionGuideDecl>(FD))
-      return;
+  bool HandleTopLevelDecl(clang::DeclGroupRef) override {
+    watchdog_.check();
+    return true;
+  }
 
-    // Pure virtual methods cannot be exported.
-    if (const auto *MD = llvm::dyn_cast<clang::CXXMethodDecl>(FD))
-      if (MD->isPureVirtual())
-        return;
+  void HandleCXXImplicitFunctionInstantiation(clang::FunctionDecl *) override {
+    watchdog_.check();
+  }
 
-    // Ignore known forward declarations (builtins)
-    if (contains(kIgnoredBuiltins, FD->getNameAsString()))
-      return;
+  void HandleTranslationUnit(clang::ASTContext &) override {
+    watchdog_.check();
+  }
 
-    // TODO(compnerd) replace with std::set::contains in C++20
-    if (contains(get_ignored_symbols(), FD->getNameAsString()))
-      return;
+private:
+  const watchdog &watchdog_;
+};
 
-    // Use the inner start location so that the annotation comes after
-    // any template information.
-    clang::SourceLocation SLoc = FD->getInnerLocStart();
+// Analyzes a source, abandoning it once it runs past the timeout, if any.
+// The digests of the files read by the analysis of a source, keyed by their
+// absolute path.
+using file_digests = std::map<std::string, std::uint64_t>;
+
+class supervised_action : public idt::action {
+  std::chrono::seconds timeout_;
+  std::optional<watchdog> watchdog_;
+  file_digests *files_;
+
+protected:
+  bool BeginSourceFileAction(clang::CompilerInstance &CI) override {
+    if (timeout_.count()) {
+      watchdog_.emplace(timeout_);
+      CI.getPreprocessor().addPPCallbacks(
+          std::make_unique<watchdog_callbacks>(*watchdog_));
+      // The analysis of the parsed translation unit may take as long as the
+      // parse, so the deadline is also checked as it visits each declaration.
+      progress_ = [this]() { watchdog_->check(); };
+    }
+    return idt::action::BeginSourceFileAction(CI);
+  }
 
-    // If the function declaration has any existing attributes, the export macro
-    // should be inserted after them. We can approximate this location using the
-    // function's return type location.
-    if (!FD->attrs().empty())
-      SLoc = FD->getTypeSourceInfo()->getTypeLoc().getBeginLoc();
+  void record_file(clang::FileManager &files, llvm::StringRef name,
+                   llvm::StringRef contents) {
+    llvm::SmallString<256> path{name};
+    files.makeAbsolutePath(path);
+    llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+    (*files_)[std::string(path)] = idt::get_digest(contents);
+  }
 
-    unexported_public_interface(FD, SLoc)
-        << FD << clang::FixItHint::CreateInsertion(SLoc, export_macro + " ");
+  // Record the files which were read, if requested, for --incremental or
+  // --watch.
+  void EndSourceFileAction() override {
+    if (files_) {
+      clang::CompilerInstance &CI = getCompilerInstance();
+      const clang::SourceManager &source_manager = CI.getSourceManager();
+      for (auto entry = source_manager.fileinfo_begin(),
+                end = source_manager.fileinfo_end();
+           entry != end; ++entry)
+        if (std::optional<llvm::StringRef> contents =
+                entry->second->getBufferDataIfLoaded())
+          record_file(CI.getFileManager(), entry->first.getName(), *contents);
+
+      // The headers of the imported modules are deserialized rather than
+      // read, but a change to them must still cause the source to be analyzed
+      // again.
+      if (llvm::IntrusiveRefCntPtr<clang::ASTReader> reader =
+              CI.getASTReader())
+        for (clang::serialization::ModuleFile &module :
+             reader->getModuleManager())
+          reader->visitInputFiles(
+              module, /*IncludeSystem=*/true, /*Complain=*/false,
+              [&](const clang::serialization::InputFile &input, bool) {
+                clang::OptionalFileEntryRef file = input.getFile();
+                if (!file)
+                  return;
+                if (auto buffer = CI.getFileManager().getBufferForFile(*file))
+                  record_file(CI.getFileManager(), file->getName(),
+                              (*buffer)->getBuffer());
+              });
+    }
+    idt::action::EndSourceFileAction();
   }
 
-  // Determine if a variable needs exporting and add the export annotation as
-  // required. This only applies to extern globals and static member fields.
-  void export_variable_if_needed(const clang::VarDecl *VD) {
-    // Check if the symbol is already exported.
-    if (is_symbol_exported(VD))
-      return;
+public:
+  supervised_action(const idt::options &options, idt::summary *summary,
+                    idt::export_index *index, std::chrono::seconds timeout,
+                    file_digests *files)
+      : idt::action(options, summary, index), timeout_(timeout),
+        files_(files) {}
 
-    // Ignore declarations from the system.
-    if (is_in_system_header(VD))
-      return;
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI,
+                    llvm::StringRef file) override {
+    std::unique_ptr<clang::ASTConsumer> consumer =
+        idt::action::CreateASTConsumer(CI, file);
+    if (!watchdog_)
+      return consumer;
+
+    std::vector<std::unique_ptr<clang::ASTConsumer>> consumers;
+    consumers.push_back(std::make_unique<watchdog_consumer>(*watchdog_));
+    consumers.push_back(std::move(consumer));
+    return std::make_unique<clang::MultiplexConsumer>(std::move(consumers));
+  }
+};
 
-    // Skip all variable declarations not in header files.
-    if (!is_in_header(VD))
-      return;
+struct factory : clang::tooling::FrontendActionFactory {
+  factory(const idt::options &options, idt::summary *summary,
+          idt::export_index *index)
+      : options_(options), summary_(summary), index_(index) {}
 
-    // Skip local variables. We are only interested in static fields.
-    if (VD->getParentFunctionOrMethod())
-      return;
+  std::unique_ptr<clang::FrontendAction> create() override {
+    return std::make_unique<supervised_action>(
+        options_, summary_, decisions_ ? &*decisions_ : nullptr,
+        std::chrono::seconds(tu_timeout),
+        records_dependencies() ? &files : nullptr);
+  }
 
-    // Skip static fields that have initializers.
-    if (VD->hasInit())
-      return;
+  // Prepare to analyze a source.
+  void start_source() {
+    files.clear();
+    if (index_)
+      decisions_.emplace(index_);
+  }
 
-    // Skip all other local and global variables unless they are extern.
-    if (!(VD->isStaticDataMember() ||
-          VD->getStorageClass() == clang::StorageClass::SC_Extern))
-      return;
+  // Add the decisions of the source which was analyzed to the index. This is
+  // not done for a source which could not be analyzed, whose decisions may not
+  // have been reported.
+  void finish_source() {
+    if (index_)
+      index_->merge(*decisions_);
+  }
 
-    // Skip fields in template declarations.
-    if (VD->getTemplateInstantiationPattern() != nullptr)
-      return;
+  // The files read by the analysis of the current source, with --incremental
+  // or --watch.
+  file_digests files;
 
-    // Skip static variables declared in template class unless the template is
-    // fully specialized.
-    if (auto *RD = llvm::dyn_cast<clang::CXXRecordDecl>(VD->getDeclContext())) {
-      if (RD->getDescribedClassTemplate())
-        return;
+private:
+  const idt::options &options_;
+  idt::summary *summary_;
+  idt::export_index *index_;
+
+  // The decisions of the current source, layered over `index_`.
+  std::optional<idt::export_index> decisions_;
+};
 
-      if (auto *CTSD = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(RD))
-        if (llvm::isa<clang::ClassTemplatePartialSpecializationDecl>(CTSD))
-          return;
+// A source which could not be analyzed.
+struct failure {
+  std::string source;
+  std::string reason;
+};
+
+// Analyzes each source on its own under a crash recovery context, so that a
+// source which crashes or runs past --tu-timeout is recorded as a failure
+// rather than ending the run, and the rest are still analyzed. The files of
+// each source are read by the prefetcher, if any, while the previous source
+// is analyzed. The declarations decided by each source which was analyzed are
+// added to the export index, and the files which it read are added to
+// `dependencies`, with --incremental or --watch.
+int run_isolated(const clang::tooling::CompilationDatabase &compilations,
+                 llvm::ArrayRef<std::string> sources,
+                 llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs,
+                 const clang::tooling::ArgumentsAdjuster &adjuster,
+                 clang::DiagnosticConsumer *diagnostics, factory &action,
+                 std::vector<failure> &failures,
+                 std::map<std::string, file_digests> &dependencies,
+                 idt::prefetcher *prefetcher = nullptr) {
+  int result = EXIT_SUCCESS;
+  for (std::size_t index = 0; index < sources.size(); ++index) {
+    const std::string &source = sources[index];
+    if (prefetcher && index + 1 < sources.size())
+      prefetcher->start(compilations.getCompileCommands(sources[index + 1]));
+    action.start_source();
+
+    clang::tooling::ClangTool tool{
+        compilations, {source},
+        std::make_shared<clang::PCHContainerOperations>(), fs};
+    if (adjuster)
+      tool.appendArgumentsAdjuster(adjuster);
+    if (!module_cache_path.empty())
+      tool.appendArgumentsAdjuster(get_module_adjuster(module_cache_path));
+    if (diagnostics)
+      tool.setDiagnosticConsumer(diagnostics);
+
+    int status = EXIT_SUCCESS;
+    llvm::CrashRecoveryContext context;
+    if (context.RunSafely([&]() { status = tool.run(&action); })) {
+      if (status != EXIT_SUCCESS) {
+        failures.push_back({source, "failed"});
+      } else {
+        action.finish_source();
+        if (records_dependencies())
+          dependencies[source] = std::move(action.files);
+      }
+    } else if (context.RetCode == kTimedOut) {
+      failures.push_back(
+          {source, "timed out after " + std::to_string(tu_timeout) + "s"});
+      status = EXIT_FAILURE;
+    } else {
+      failures.push_back({source, "crashed"});
+      status = EXIT_FAILURE;
     }
+    if (status != EXIT_SUCCESS)
+      result = status;
+  }
+  return result;
+}
 
-    // TODO(compnerd) replace with std::set::contains in C++20
-    if (contains(get_ignored_symbols(), VD->getNameAsString()))
-      return;
+void print_failures(llvm::raw_ostream &os,
+                    llvm::ArrayRef<failure> failures) {
+  if (failures.empty())
+    return;
 
-    clang::SourceLocation SLoc = VD->getBeginLoc();
+  os << "sources which could not be analyzed: " << failures.size() << '\n';
+  for (const failure &entry : failures)
+    os << "  " << entry.source << ": " << entry.reason << '\n';
+}
 
-    // If the variable declaration has any existing attributes, the export macro
-    // should be inserted after them. Similarly, if the variable has external
-    // storage, the export macro should be inserted after the extern keyword. We
-    // can approximate this location using the variable's type location.
-    if (!VD->attrs().empty() || VD->hasExternalStorage())
-      SLoc = VD->getTypeSourceInfo()->getTypeLoc().getBeginLoc();
+// Analyzes the sources again whenever a file which they read changes, until
+// the process is interrupted. The files are polled, as the facilities to watch
+// them differ between the platforms, and are read through a cache which is
+// kept between the changes, so that only the changed files are read again.
+// Each pass reports the diagnostics of the affected sources only.
+void watch_sources(const clang::tooling::CompilationDatabase &compilations,
+                   llvm::ArrayRef<std::string> sources,
+                   const clang::tooling::ArgumentsAdjuster &adjuster,
+                   const idt::options &options,
+                   std::map<std::string, file_digests> &dependencies) {
+  // The sources which read each file. A file which is no longer read is still
+  // watched, which only causes an unnecessary analysis.
+  idt::file_watcher watcher;
+  std::map<std::string, std::set<std::size_t>> dependents;
+  const auto track = [&](std::size_t source) {
+    const std::string path = get_absolute_path(sources[source]);
+    watcher.watch(path);
+    dependents[path].insert(source);
+
+    const auto files = dependencies.find(sources[source]);
+    if (files == dependencies.end())
+      return;
+    for (const auto &file : files->second) {
+      watcher.watch(file.first);
+      dependents[file.first].insert(source);
+    }
+  };
+  for (std::size_t source = 0; source < sources.size(); ++source)
+    track(source);
+  llvm::errs() << "watching " << watcher.size() << " files\n";
+
+  idt::file_cache cache;
+  factory action{options, nullptr, nullptr};
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+    std::set<std::size_t> affected;
+    for (const std::string &path : watcher.poll()) {
+      cache.invalidate(path);
+      const auto entry = dependents.find(path);
+      if (entry != dependents.end())
+        affected.insert(entry->second.begin(), entry->second.end());
+    }
+    if (affected.empty())
+      continue;
+
+    std::vector<std::string> changed;
+    for (std::size_t source : affected)
+      changed.push_back(sources[source]);
+    llvm::errs() << "analyzing " << changed.size() << " affected sources\n";
+
+    std::vector<failure> failures;
+    run_isolated(compilations, changed,
+                 llvm::makeIntrusiveRefCnt<idt::cached_file_system>(
+                     cache, llvm::vfs::createPhysicalFileSystem()),
+                 adjuster, nullptr, action, failures, dependencies);
+    print_failures(llvm::errs(), failures);
+
+    for (std::size_t source : affected)
+      track(source);
+  }
+}
 
-    unexported_public_interface(VD, SLoc)
-        << VD << clang::FixItHint::CreateInsertion(SLoc, export_macro + " ");
+// Preprocesses a translation unit to find the files which it reaches that may
+// declare the targeted symbols. This avoids parsing the translation units
+// which cannot contribute an annotation.
+class reference_scan_action : public clang::PreprocessOnlyAction {
+  const std::vector<std::string> &identifiers_;
+  llvm::StringMap<bool> &cache_;
+  std::set<std::string> &files_;
+
+protected:
+  bool BeginSourceFileAction(clang::CompilerInstance &CI) override {
+    CI.getPreprocessor().addPPCallbacks(
+        std::make_unique<symbol_reference_scanner>(CI.getSourceManager(),
+                                                   identifiers_, cache_,
+                                                   files_));
+    return true;
   }
 
-  // Determine if a tagged type needs exporting at the record level and add the
-  // export annotation as required.
-  void export_record_if_needed(clang::CXXRecordDecl *RD) {
-    // Check if the class is already exported.
-    if (is_symbol_exported(RD))
-      return;
+public:
+  reference_scan_action(const std::vector<std::string> &identifiers,
+                        llvm::StringMap<bool> &cache,
+                        std::set<std::string> &files)
+      : identifiers_(identifiers), cache_(cache), files_(files) {}
+};
 
-    // Ignore declarations from the system.
-    if (is_in_system_header(RD))
-      return;
+struct reference_scan_factory : clang::tooling::FrontendActionFactory {
+  reference_scan_factory(const std::vector<std::string> &identifiers,
+                         llvm::StringMap<bool> &cache,
+                         std::set<std::string> &files)
+      : identifiers_(identifiers), cache_(cache), files_(files) {}
 
-    // Skip exporting template classes. For fully-specialized template classes,
-    // isTemplated() returns false so they will be annotated if needed.
-    if (RD->isTemplated())
-      return;
+  std::unique_ptr<clang::FrontendAction> create() override {
+    return std::make_unique<reference_scan_action>(identifiers_, cache_,
+                                                   files_);
+  }
 
-    // If a class declaration contains an out-of-line virtual method, annotate
-    // the class instead of its individual members. This ensures its vtable is
-    // exported on non-Windows platforms. Do this regardless of the method's
-    // access level.
-    bool should_export_record = false;
-    for (const auto *MD : RD->methods())
-      if ((should_export_record =
-               !(MD->isPureVirtual() || MD->isDefaulted() || MD->isDeleted()) &&
-               (MD->isVirtual() && !MD->hasBody())))
-        break;
+private:
+  const std::vector<std::string> &identifiers_;
+  llvm::StringMap<bool> &cache_;
+  std::set<std::string> &files_;
+};
 
-    if (!should_export_record)
-      return;
+// Select the sources which reach a file that may declare one of the symbols.
+// As every translation unit reaching a header finds the same declarations in
+// it, only the first translation unit to reach each such file is selected.
+std::vector<std::string>
+select_sources(const clang::tooling::CompilationDatabase &compilations,
+               llvm::ArrayRef<std::string> sources,
+               const std::set<std::string> &symbols) {
+  const std::vector<std::string> identifiers =
+      get_symbol_identifiers(symbols);
+
+  // Any errors are reported when the selected sources are scanned.
+  clang::IgnoringDiagConsumer ignore;
+
+  llvm::StringMap<bool> cache;
+  std::set<std::string> covered;
+  std::vector<std::string> selected;
+  for (const std::string &source : sources) {
+    std::set<std::string> files;
+    clang::tooling::ClangTool tool{compilations, {source}};
+    tool.setDiagnosticConsumer(&ignore);
+    reference_scan_factory factory{identifiers, cache, files};
+
+    // Conservatively select a source which cannot be preprocessed.
+    if (tool.run(&factory)) {
+      selected.push_back(source);
+      continue;
+    }
 
-    // Insert the annotation immediately before the tag name, which is the
-    // position returned by getLocation.
-    clang::LangOptions LO = RD->getASTContext().getLangOpts();
-    clang::SourceLocation SLoc = RD->getQualifier()
-                                     ? RD->getQualifierLoc().getBeginLoc()
-                                     : RD->getLocation();
-    const clang::SourceLocation location =
-        context_.getFullLoc(SLoc).getExpansionLoc();
-    unexported_public_interface(RD, location)
-        << RD << clang::FixItHint::CreateInsertion(SLoc, export_macro + " ");
+    bool reaches_new_file = false;
+    for (const std::string &file : files)
+      reaches_new_file |= covered.insert(file).second;
+    if (reaches_new_file)
+      selected.push_back(source);
   }
+  return selected;
+}
 
-public:
-  visitor(clang::ASTContext &context, PPCallbacks::FileIncludes &file_includes)
-      : context_(context), source_manager_(context.getSourceManager()),
-        file_includes_(file_includes) {}
-
-  bool TraverseCXXRecordDecl(clang::CXXRecordDecl *RD) {
-    export_record_if_needed(RD);
-
-    // Traverse the class by invoking the parent's version of this method. This
-    // call is required even if the record is exported because it may contain
-    // nested records.
-    return RecursiveASTVisitor::TraverseCXXRecordDecl(RD);
-  }
-
-  // RecursiveASTVisitor::TraverseCXXRecordDecl does not get called for fully
-  // specialized template declarations. Since we may want to export them,
-  // manually invoke TraverseCXXRecordDecl whenever an explicit specialization
-  // is found.
-  bool TraverseClassTemplateSpecializationDecl(
-      clang::ClassTemplateSpecializationDecl *SD) {
-    switch (SD->getSpecializationKind()) {
-    case clang::TSK_ExplicitSpecialization:
-      // This call visits class template specialization record and recursively
-      // visits all of it children, which may also require export.
-      return TraverseCXXRecordDecl(SD);
-
-    // TODO: consider annotating explicit template instantiation declarations
-    // and definitions in the future. They may require unique annotation macros
-    // due to differences between visibility and dllexport/dllimport attributes.
-    case clang::TSK_ExplicitInstantiationDeclaration:
-      [[fallthrough]];
-    case clang::TSK_ExplicitInstantiationDefinition:
-      [[fallthrough]];
-    default:
-      return true;
-    }
+// Parses a client translation unit to find the library declarations which it
+// references.
+class client_usage_action : public clang::ASTFrontendAction {
+  std::set<std::string> &references_;
+
+protected:
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &, llvm::StringRef) override {
+    return std::make_unique<client_usage_consumer>(references_);
   }
 
-  // VisitFunctionDecl will visit all function declarations. This includes top-
-  // level functions as well as class member and static functions.
-  bool VisitFunctionDecl(clang::FunctionDecl *FD) {
-    // Ignore private member function declarations. Any that require export will
-    // be identified by VisitCallExpr.
-    if (const auto *MD = llvm::dyn_cast<clang::CXXMethodDecl>(FD))
-      if (MD->getAccess() == clang::AccessSpecifier::AS_private)
-        return true;
+public:
+  explicit client_usage_action(std::set<std::string> &references)
+      : references_(references) {}
+};
 
-    export_function_if_needed(FD);
-    return true;
+struct client_usage_factory : clang::tooling::FrontendActionFactory {
+  explicit client_usage_factory(std::set<std::string> &references)
+      : references_(references) {}
+
+  std::unique_ptr<clang::FrontendAction> create() override {
+    return std::make_unique<client_usage_action>(references_);
   }
 
-  // Visit every function call in the compilation unit to determine if there are
-  // any inline calls to private member functions. In this uncommon case, the
-  // private method must be annotated for export.
-  bool VisitCallExpr(clang::CallExpr *CE) {
-    const clang::FunctionDecl *FD = CE->getDirectCallee();
-    if (!FD)
-      return true;
+private:
+  std::set<std::string> &references_;
+};
 
-    const clang::CXXMethodDecl *MD = llvm::dyn_cast<clang::CXXMethodDecl>(FD);
-    if (!MD)
-      return true;
+// Add the declarations referenced by the sources of the compilation database
+// in `directory`, the clients of the libraries, to `symbols`. The clients must
+// all be analyzed, as a reference which is missed would fail their link.
+bool read_client_references(llvm::StringRef directory,
+                            std::set<std::string> &symbols) {
+  std::string error;
+  std::unique_ptr<clang::tooling::CompilationDatabase> clients =
+      clang::tooling::CompilationDatabase::loadFromDirectory(directory, error);
+  if (!clients) {
+    llvm::errs() << "unable to load the compilation database of the clients: "
+                 << error << "\n";
+    return false;
+  }
 
-    // Only consider private methods here. Non-private methods will be
-    // considered for export by  VisitFunctionDecl.
-    if (MD->getAccess() == clang::AccessSpecifier::AS_private)
-      export_function_if_needed(MD);
+  clang::tooling::ClangTool tool{*clients, clients->getAllFiles()};
+  client_usage_factory factory{symbols};
+  if (tool.run(&factory)) {
+    llvm::errs() << "unable to analyze the clients in '" << directory
+                 << "'\n";
+    return false;
+  }
+  return true;
+}
 
-    return true;
+// Analyzes the sources in each configuration in parallel, reading each file
+// once, and merges the results into `summary` and `index`. The diagnostics of
+// each configuration are printed once it completes, in order.
+int run_configurations(const clang::tooling::CompilationDatabase &compilations,
+                       llvm::ArrayRef<std::string> sources,
+                       const idt::options &options, idt::summary &summary,
+                       idt::export_index *index,
+                       std::vector<failure> &failures,
+                       std::map<std::string, file_digests> &dependencies) {
+  const std::size_t count = options.configurations.size();
+
+  // The changes are merged rather than applied by each configuration, and
+  // each configuration decides independently which declarations to export
+  // so that the configurations can be compared.
+  std::vector<idt::options> configurations(count, options);
+  std::vector<std::unique_ptr<idt::summary>> summaries;
+  std::vector<std::unique_ptr<idt::export_index>> indices;
+  for (std::size_t configuration = 0; configuration < count; ++configuration) {
+    configurations[configuration].apply_fixits = false;
+    summaries.push_back(std::make_unique<idt::summary>(
+        configurations[configuration], configuration));
+    indices.push_back(
+        std::make_unique<idt::export_index>(options.apply_fixits));
+    if (index)
+      indices.back()->merge(*index);
   }
 
-  // Visit every unresolved member expression in the compilation unit to
-  // determine if there are overloaded private methods that might be called. In
-  // this uncommon case, the private method should be annotated.
-  bool VisitUnresolvedMemberExpr(clang::UnresolvedMemberExpr *E) {
-    // Iterate over potential declarations
-    for (const clang::NamedDecl *ND : E->decls())
-      if (const auto *MD = llvm::dyn_cast<clang::CXXMethodDecl>(ND))
-        if (MD->getAccess() == clang::AccessSpecifier::AS_private)
-          export_function_if_needed(MD);
+  idt::file_cache cache;
+  llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> diagnostic_options{
+      new clang::DiagnosticOptions()};
+  std::vector<std::string> diagnostics(count);
+  std::vector<int> results(count, EXIT_SUCCESS);
+  std::vector<std::vector<failure>> configuration_failures(count);
+  std::vector<std::map<std::string, file_digests>> configuration_dependencies(
+      count);
+
+  std::vector<std::thread> threads;
+  for (std::size_t configuration = 0; configuration < count; ++configuration)
+    threads.emplace_back([&, configuration]() {
+      llvm::raw_string_ostream os(diagnostics[configuration]);
+      clang::TextDiagnosticPrinter printer{os, diagnostic_options.get()};
+
+      factory action{configurations[configuration],
+                     summaries[configuration].get(),
+                     index ? indices[configuration].get() : nullptr};
+      std::optional<idt::prefetcher> prefetcher;
+      if (prefetch)
+        prefetcher.emplace(cache, llvm::vfs::createPhysicalFileSystem());
+      results[configuration] = run_isolated(
+          compilations, sources,
+          llvm::makeIntrusiveRefCnt<idt::cached_file_system>(
+              cache, llvm::vfs::createPhysicalFileSystem()),
+          get_configuration_adjuster(options.configurations[configuration]),
+          &printer, action, configuration_failures[configuration],
+          configuration_dependencies[configuration],
+          prefetcher ? &*prefetcher : nullptr);
+    });
+
+  int result = EXIT_SUCCESS;
+  for (std::size_t configuration = 0; configuration < count; ++configuration) {
+    threads[configuration].join();
+
+    llvm::errs() << "configuration " << configuration + 1 << ": "
+                 << options.configurations[configuration] << '\n'
+                 << diagnostics[configuration];
+    summary.merge(*summaries[configuration]);
+    if (index)
+      index->merge(*indices[configuration]);
+    for (failure &entry : configuration_failures[configuration])
+      failures.push_back(
+          {std::move(entry.source),
+           entry.reason + " in configuration " +
+               std::to_string(configuration + 1)});
+    if (results[configuration] != EXIT_SUCCESS)
+      result = results[configuration];
+  }
 
-    return true;
+  // A source is only recorded if it was analyzed in every configuration, with
+  // the files read by any of them.
+  for (const auto &entry : configuration_dependencies.front()) {
+    file_digests files;
+    bool analyzed = true;
+    for (const auto &configuration : configuration_dependencies) {
+      const auto source = configuration.find(entry.first);
+      if (source == configuration.end()) {
+        analyzed = false;
+        break;
+      }
+      files.insert(source->second.begin(), source->second.end());
+    }
+    if (analyzed)
+      dependencies[entry.first] = std::move(files);
   }
+  return result;
+}
+}
 
-  // Visit every constructor call in the compilation unit to determine if there
-  // are any inline calls to private constructors. In this uncommon case, the
-  // private constructor must be annotated for export. Constructor calls are not
-  // visited by VisitCallExpr.
-  bool VisitCXXConstructExpr(clang::CXXConstructExpr *CE) {
-    const clang::CXXConstructorDecl *CD = CE->getConstructor();
-    if (!CD)
-      return true;
+int main(int argc, char *argv[]) {
+  using namespace clang::tooling;
 
-    // Only consider private constructors here. Non-private constructors will be
-    // considered for export by  VisitFunctionDecl.
-    if (CD->getAccess() == clang::AccessSpecifier::AS_private)
-      export_function_if_needed(CD);
+  if (argc == 4 && (llvm::StringRef(argv[1]) == "--diff-snapshot" ||
+                    llvm::StringRef(argv[1]) == "-diff-snapshot"))
+    return diff_snapshots(argv[2], argv[3]);
+
+  // A source which crashes is recorded as a failure rather than ending the run.
+  llvm::CrashRecoveryContext::Enable();
+
+  // A replay analyzes the sources of the reproducer with its compile commands,
+  // which are added to the command line.
+  std::vector<const char *> arguments(argv, argv + argc);
+  std::unique_ptr<CompilationDatabase> reproducer;
+  std::vector<std::string> reproducer_sources;
+  if (std::optional<std::string> directory = get_replay_directory(arguments)) {
+    llvm::SmallString<256> path{*directory};
+    llvm::sys::path::append(path, "compile_commands.json");
+
+    std::string error;
+    reproducer = JSONCompilationDatabase::loadFromFile(
+        path, error, JSONCommandLineSyntax::AutoDetect);
+    if (!reproducer) {
+      llvm::errs() << "unable to read reproducer '" << *directory
+                   << "': " << error << "\n";
+      return EXIT_FAILURE;
+    }
 
-    return true;
+    reproducer_sources = reproducer->getAllFiles();
+    for (const std::string &source : reproducer_sources)
+      arguments.push_back(source.c_str());
+    arguments.push_back("--");
   }
 
-  // VisitVarDecl will visit all variable declarations as well as static fields
-  // in classes and structs. Non-static fields are not visited by this method.
-  bool VisitVarDecl(clang::VarDecl *VD) {
-    // Ignore private static field declarations. Any that require export will be
-    // identified by VisitDeclRefExpr.
-    if (VD->getAccess() == clang::AccessSpecifier::AS_private)
-      return true;
+  int count = static_cast<int>(arguments.size());
+  auto options = CommonOptionsParser::create(count, arguments.data(),
+                                             idt::category,
+                                             llvm::cl::OneOrMore);
+  if (options) {
+    idt::options configuration = get_options();
+    if (reproducer) {
+      llvm::Expected<idt::options> recorded =
+          idt::read_reproducer_options(replay);
+      if (!recorded) {
+        llvm::logAllUnhandledErrors(recorded.takeError(), llvm::errs());
+        return EXIT_FAILURE;
+      }
+      add_reporting_options(*recorded, configuration);
+      configuration = std::move(*recorded);
+    }
+    if (!validate_options(configuration))
+      return EXIT_FAILURE;
+
+    const CompilationDatabase &compilations =
+        reproducer ? *reproducer : options->getCompilations();
+    std::vector<std::string> sources = options->getSourcePathList();
+    if (!from_link_log.empty() || !from_clients.empty()) {
+      if (!from_link_log.empty()) {
+        if (!read_link_log(from_link_log, configuration.target_symbols))
+          return EXIT_FAILURE;
+
+        if (configuration.target_symbols.empty()) {
+          llvm::errs() << "no undefined symbols found in '" << from_link_log
+                       << "'\n";
+          return EXIT_SUCCESS;
+        }
+      }
+
+      if (!from_clients.empty()) {
+        if (!idt::read_client_references(from_clients,
+                                         configuration.target_symbols))
+          return EXIT_FAILURE;
+
+        if (configuration.target_symbols.empty()) {
+          llvm::errs() << "no references found in the clients in '"
+                       << from_clients << "'\n";
+          return EXIT_SUCCESS;
+        }
+      }
+
+      sources = idt::select_sources(compilations, sources,
+                                    configuration.target_symbols);
+      if (sources.empty())
+        return EXIT_SUCCESS;
+    }
 
-    export_variable_if_needed(VD);
-    return true;
-  }
+    if (!capture.empty() &&
+        (sources.size() != 1 || configuration.configurations.size() > 1)) {
+      llvm::errs() << "--capture requires a single source and configuration\n";
+      return EXIT_FAILURE;
+    }
 
-  // Visit every variable reference in the compilation unit to determine if
-  // there are any inline references to private, static member fields. In this
-  // uncommon case, the private field must be annotated for export.
-  bool VisitDeclRefExpr(clang::DeclRefExpr *DRE) {
-    // Only consider expresions referencing variable declarations. This includes
-    // static fields and local variables but not member variables, which are
-    // type FieldDecl.
-    auto *VD = llvm::dyn_cast<clang::VarDecl>(DRE->getDecl());
-    if (!VD)
-      return true;
+    // The modules are written to the disk, which a replay does not read.
+    if (!module_cache_path.empty() && (!capture.empty() || reproducer)) {
+      llvm::errs() << "--module-cache-path cannot be used with --capture or "
+                      "--replay\n";
+      return EXIT_FAILURE;
+    }
 
-    // Only consider private fields here. Non-private fields will be considered
-    // for export by VisitVarDecl.
-    if (VD->getAccess() != clang::AccessSpecifier::AS_private)
-      return true;
+    // The files are analyzed again as they change, which rewriting them would
+    // cause, and only the files of the sources which are analyzed are known.
+    if (watch && (configuration.apply_fixits || !capture.empty() ||
+                  !incremental.empty() || reproducer ||
+                  configuration.configurations.size() > 1)) {
+      llvm::errs() << "--watch cannot be used with --apply-fixits, --capture, "
+                      "--incremental, --replay or several configurations\n";
+      return EXIT_FAILURE;
+    }
 
-    export_variable_if_needed(VD);
-    return true;
-  }
-};
+    // These outputs cover the whole interface, which the sources skipped by
+    // --incremental would be missing from.
+    if (!incremental.empty() &&
+        (configuration.symbol_file != idt::symbol_file_format::none ||
+         configuration.snapshot || configuration.findings ||
+         configuration.export_report || configuration.over_exports)) {
+      llvm::errs() << "--incremental cannot be used with --export-report, "
+                      "--findings, --over-exports, --snapshot or "
+                      "--symbol-file\n";
+      return EXIT_FAILURE;
+    }
 
-class consumer : public clang::ASTConsumer {
-  struct fixit_options : clang::FixItOptions {
-    fixit_options() {
-      InPlace = inplace;
-      Silent = apply_fixits;
+    // With --incremental, the sources whose files and compile commands are
+    // unchanged since they were recorded are skipped. The other arguments of
+    // the run are part of the digest of each command.
+    idt::incremental_record record;
+    std::map<std::string, std::pair<std::string, std::uint64_t>> commands;
+    if (!incremental.empty()) {
+      if (llvm::Error error = record.load(incremental)) {
+        llvm::logAllUnhandledErrors(std::move(error), llvm::errs());
+        return EXIT_FAILURE;
+      }
+
+      const std::set<std::string> paths{options->getSourcePathList().begin(),
+                                        options->getSourcePathList().end()};
+      std::string settings;
+      for (std::size_t index = 1; index < arguments.size(); ++index)
+        if (!paths.count(arguments[index]))
+          settings.append(arguments[index]).push_back('\0');
+
+      std::vector<std::string> changed;
+      for (const std::string &source : sources) {
+        auto &command = commands[source];
+        command = {get_absolute_path(source),
+                   get_command_digest(compilations, source, settings)};
+        if (!record.is_current(command.first, command.second))
+          changed.push_back(source);
+      }
+
+      if (changed.size() != sources.size())
+        llvm::errs() << "skipped " << sources.size() - changed.size()
+                     << " unchanged sources\n";
+      sources = std::move(changed);
     }
 
-    std::string RewriteFilename(const std::string &filename, int &fd) override {
-      llvm_unreachable("unexpected call to RewriteFilename");
+    // A replay reads the files from memory only, and a capture records the
+    // files which are read.
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs =
+        llvm::vfs::getRealFileSystem();
+    idt::reproducer recording;
+    if (reproducer) {
+      llvm::Expected<llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>> files =
+          idt::read_reproducer_files(replay);
+      if (!files) {
+        llvm::logAllUnhandledErrors(files.takeError(), llvm::errs());
+        return EXIT_FAILURE;
+      }
+      fs = std::move(*files);
+    } else if (!capture.empty()) {
+      fs = llvm::makeIntrusiveRefCnt<idt::recording_file_system>(recording,
+                                                                 fs);
     }
-  };
 
-  idt::visitor visitor_;
+    // The prefetched files are read from the cache by the analysis. There is
+    // nothing to prefetch for a replay, and a capture must see every read.
+    idt::file_cache cache;
+    std::optional<idt::prefetcher> prefetcher;
+    if (prefetch && !reproducer && capture.empty()) {
+      fs = llvm::makeIntrusiveRefCnt<idt::cached_file_system>(cache, fs);
+      prefetcher.emplace(cache, llvm::vfs::createPhysicalFileSystem());
+    }
 
-  fixit_options options_;
-  std::unique_ptr<clang::FixItRewriter> rewriter_;
+    const bool summarize = configuration.over_exports ||
+                           configuration.export_report ||
+                           configuration.extern_templates ||
+                           configuration.profile_headers ||
+                           configuration.symbol_file !=
+                               idt::symbol_file_format::none ||
+                           configuration.snapshot || configuration.findings ||
+                           configuration.stats ||
+                           !configuration.target_symbols.empty() ||
+                           configuration.configurations.size() > 1;
+
+    // The time trace profiler also records the events which clang records for
+    // -ftime-trace, including the time spent in each header.
+    if (!profile_trace.empty())
+      llvm::timeTraceProfilerInitialize(/*TimeTraceGranularity=*/500, "idt");
+
+    idt::export_index index{configuration.apply_fixits};
+    if (!export_index.empty()) {
+      if (llvm::Error error = index.load(export_index)) {
+        llvm::logAllUnhandledErrors(std::move(error), llvm::errs());
+        return EXIT_FAILURE;
+      }
+    }
 
-public:
-  consumer(clang::ASTContext &context, PPCallbacks::FileIncludes &file_includes)
-      : visitor_(context, file_includes) {}
-
-  void HandleTranslationUnit(clang::ASTContext &context) override {
-    if (apply_fixits) {
-      clang::DiagnosticsEngine &diagnostics_engine = context.getDiagnostics();
-      rewriter_ =
-          std::make_unique<clang::FixItRewriter>(diagnostics_engine,
-                                                 context.getSourceManager(),
-                                                 context.getLangOpts(),
-                                                 &options_);
-      diagnostics_engine.setClient(rewriter_.get(), /*ShouldOwnClient=*/false);
+    idt::summary summary{configuration};
+    std::vector<idt::failure> failures;
+    std::map<std::string, idt::file_digests> dependencies;
+    int result = EXIT_SUCCESS;
+    if (configuration.configurations.size() > 1) {
+      result = idt::run_configurations(
+          compilations, sources, configuration, summary,
+          export_index.empty() ? nullptr : &index, failures, dependencies);
+    } else {
+      idt::factory factory{configuration, summarize ? &summary : nullptr,
+                           export_index.empty() ? nullptr : &index};
+      result = idt::run_isolated(
+          compilations, sources, fs,
+          configuration.configurations.empty()
+              ? ArgumentsAdjuster()
+              : get_configuration_adjuster(
+                    configuration.configurations.front()),
+          nullptr, factory, failures, dependencies,
+          prefetcher ? &*prefetcher : nullptr);
+    }
+    if (summarize)
+      summary.print(llvm::errs());
+    idt::print_failures(llvm::errs(), failures);
+
+    if (!incremental.empty()) {
+      for (const std::string &source : sources) {
+        const auto &command = commands[source];
+        const auto files = dependencies.find(source);
+        if (files == dependencies.end())
+          record.remove(command.first);
+        else
+          record.update(command.first, command.second,
+                        std::move(files->second));
+      }
+
+      if (llvm::Error error = record.save(incremental)) {
+        llvm::logAllUnhandledErrors(std::move(error), llvm::errs());
+        if (result == EXIT_SUCCESS)
+          result = EXIT_FAILURE;
+      }
     }
 
-    visitor_.TraverseDecl(context.getTranslationUnitDecl());
+    if (!capture.empty()) {
+      if (llvm::Error error = recording.write(
+              capture,
+              get_capture_commands(compilations, sources.front(),
+                                   configuration, argv[0]),
+              configuration)) {
+        llvm::logAllUnhandledErrors(std::move(error), llvm::errs());
+        if (result == EXIT_SUCCESS)
+          result = EXIT_FAILURE;
+      } else {
+        llvm::errs() << "captured " << recording.size() << " files in '"
+                     << capture << "'\n";
+      }
+    }
 
-    if (apply_fixits)
-      rewriter_->WriteFixedFiles();
-  }
-};
+    if (configuration.configurations.size() > 1 && configuration.apply_fixits) {
+      if (llvm::Error error = summary.fixits().apply()) {
+        llvm::logAllUnhandledErrors(std::move(error), llvm::errs());
+        if (result == EXIT_SUCCESS)
+          result = EXIT_FAILURE;
+      }
+    }
 
-struct action : clang::ASTFrontendAction {
-  void ExecuteAction() override {
-    if (!include_header.empty())
-      installPPCallbacks();
-    clang::ASTFrontendAction::ExecuteAction();
-  }
+    if (!symbol_file.empty() && !write_symbol_file(symbol_file, summary) &&
+        result == EXIT_SUCCESS)
+      result = EXIT_FAILURE;
 
-  std::unique_ptr<clang::ASTConsumer>
-  CreateASTConsumer(clang::CompilerInstance &CI, llvm::StringRef) override {
-    return std::make_unique<idt::consumer>(CI.getASTContext(), file_includes_);
-  }
+    if (!findings.empty() && !write_findings(findings, summary) &&
+        result == EXIT_SUCCESS)
+      result = EXIT_FAILURE;
 
-private:
-  // Install a callback that will be invoked on every preprocessor include
-  // statement. This is done so we can determine if a user-specified custom
-  // include statment needs to be added if any annotations are added.
-  void installPPCallbacks() {
-    clang::CompilerInstance &compiler_instance = getCompilerInstance();
-    clang::Preprocessor &preprocessor = compiler_instance.getPreprocessor();
-    clang::SourceManager &source_manager = compiler_instance.getSourceManager();
-    preprocessor.addPPCallbacks(
-        std::make_unique<PPCallbacks>(source_manager, file_includes_));
-  }
-
-  PPCallbacks::FileIncludes file_includes_;
-};
+    if (!export_index.empty()) {
+      if (llvm::Error error = index.save(export_index)) {
+        llvm::logAllUnhandledErrors(std::move(error), llvm::errs());
+        if (result == EXIT_SUCCESS)
+          result = EXIT_FAILURE;
+      }
+    }
 
-struct factory : clang::tooling::FrontendActionFactory {
-  std::unique_ptr<clang::FrontendAction> create() override {
-    return std::make_unique<idt::action>();
-  }
-};
-}
+    if (!snapshot.empty()) {
+      if (llvm::Error error = summary.snapshot().write(snapshot)) {
+        llvm::logAllUnhandledErrors(std::move(error), llvm::errs());
+        if (result == EXIT_SUCCESS)
+          result = EXIT_FAILURE;
+      }
+    }
 
-int main(int argc, char *argv[]) {
-  using namespace clang::tooling;
+    if (!profile_trace.empty()) {
+      if (!write_trace(profile_trace) && result == EXIT_SUCCESS)
+        result = EXIT_FAILURE;
+      llvm::timeTraceProfilerCleanup();
+    }
 
-  auto options =
-      CommonOptionsParser::create(argc, const_cast<const char **>(argv),
-                                  idt::category, llvm::cl::OneOrMore);
-  if (options) {
-    ClangTool tool{options->getCompilations(), options->getSourcePathList()};
-    return tool.run(new idt::factory{});
+    if (watch)
+      idt::watch_sources(compilations, sources,
+                         configuration.configurations.empty()
+                             ? ArgumentsAdjuster()
+                             : get_configuration_adjuster(
+                                   configuration.configurations.front()),
+                         configuration, dependencies);
+    return result;
   } else {
     llvm::logAllUnhandledErrors(std::move(options.takeError()), llvm::errs());
     return EXIT_FAILURE;
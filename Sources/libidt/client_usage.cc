@@ -0,0 +1,135 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/client_usage.hh"
+
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include <vector>
+
+namespace {
+class client_usage_visitor
+    : public clang::RecursiveASTVisitor<client_usage_visitor> {
+  const clang::SourceManager &source_manager_;
+  std::set<std::string> &references_;
+
+  // The inline functions of the library whose definitions remain to be
+  // visited, and those which have been queued.
+  std::vector<const clang::FunctionDecl *> pending_;
+  llvm::SmallPtrSet<const clang::FunctionDecl *, 32> queued_;
+
+  // Determine if the declaration belongs to a library rather than to the
+  // client or to the system.
+  bool is_library_declaration(const clang::Decl *D) const {
+    const clang::SourceLocation location =
+        source_manager_.getExpansionLoc(D->getLocation());
+    return location.isValid() && !source_manager_.isInMainFile(location) &&
+           !source_manager_.isInSystemHeader(location);
+  }
+
+  void reference(const clang::NamedDecl *D) {
+    if (!D || !is_library_declaration(D))
+      return;
+
+    if (const auto *VD = llvm::dyn_cast<clang::VarDecl>(D))
+      if (!VD->hasGlobalStorage() || VD->isStaticLocal())
+        return;
+
+    if (!llvm::isa<clang::FunctionDecl>(D) && !llvm::isa<clang::VarDecl>(D) &&
+        !llvm::isa<clang::CXXRecordDecl>(D))
+      return;
+
+    references_.insert(D->getQualifiedNameAsString());
+
+    const auto *FD = llvm::dyn_cast<clang::FunctionDecl>(D);
+    if (!FD)
+      return;
+
+    const clang::FunctionDecl *definition = nullptr;
+    if (FD->hasBody(definition) && definition->isInlined() &&
+        is_library_declaration(definition) && queued_.insert(definition).second)
+      pending_.push_back(definition);
+  }
+
+public:
+  client_usage_visitor(const clang::SourceManager &source_manager,
+                       std::set<std::string> &references)
+      : source_manager_(source_manager), references_(references) {}
+
+  bool shouldVisitTemplateInstantiations() const { return true; }
+  bool shouldVisitImplicitCode() const { return true; }
+
+  // Visit the declarations of the main file, and then the definitions of the
+  // inline functions of the library which they reach.
+  void visit(clang::ASTContext &context) {
+    for (clang::Decl *D : context.getTranslationUnitDecl()->decls())
+      if (source_manager_.isInMainFile(
+              source_manager_.getExpansionLoc(D->getLocation())))
+        TraverseDecl(D);
+
+    while (!pending_.empty()) {
+      const clang::FunctionDecl *FD = pending_.back();
+      pending_.pop_back();
+      TraverseDecl(const_cast<clang::FunctionDecl *>(FD));
+    }
+  }
+
+  bool VisitDeclRefExpr(clang::DeclRefExpr *DRE) {
+    reference(DRE->getDecl());
+    return true;
+  }
+
+  bool VisitMemberExpr(clang::MemberExpr *ME) {
+    reference(ME->getMemberDecl());
+    return true;
+  }
+
+  bool VisitCXXConstructExpr(clang::CXXConstructExpr *CE) {
+    const clang::CXXConstructorDecl *CD = CE->getConstructor();
+    reference(CD);
+
+    const clang::CXXRecordDecl *RD = CD->getParent();
+    reference(RD);
+    if (const clang::CXXDestructorDecl *DD = RD->getDestructor())
+      reference(DD);
+    return true;
+  }
+
+  bool VisitCXXDeleteExpr(clang::CXXDeleteExpr *DE) {
+    const clang::QualType type = DE->getDestroyedType();
+    if (type.isNull())
+      return true;
+    if (const clang::CXXRecordDecl *RD = type->getAsCXXRecordDecl())
+      if (const clang::CXXDestructorDecl *DD = RD->getDestructor())
+        reference(DD);
+    return true;
+  }
+
+  // The type information of a class is emitted with its vtable.
+  bool VisitCXXTypeidExpr(clang::CXXTypeidExpr *TE) {
+    if (!TE->isTypeOperand())
+      return true;
+    reference(TE->getTypeOperandSourceInfo()->getType()->getAsCXXRecordDecl());
+    return true;
+  }
+
+  bool VisitCXXDynamicCastExpr(clang::CXXDynamicCastExpr *CE) {
+    clang::QualType type = CE->getTypeAsWritten();
+    if (const auto *PT = type->getAs<clang::PointerType>())
+      type = PT->getPointeeType();
+    else if (const auto *RT = type->getAs<clang::ReferenceType>())
+      type = RT->getPointeeType();
+    reference(type->getAsCXXRecordDecl());
+    return true;
+  }
+};
+}
+
+namespace idt {
+void client_usage_consumer::HandleTranslationUnit(clang::ASTContext &context) {
+  client_usage_visitor visitor{context.getSourceManager(), references_};
+  visitor.visit(context);
+}
+}
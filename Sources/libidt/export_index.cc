@@ -0,0 +1,118 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/export_index.hh"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <system_error>
+#include <vector>
+
+namespace idt {
+export_index::shard &export_index::get_shard(llvm::StringRef usr) {
+  return shards_[llvm::xxh3_64bits(usr) % kShards];
+}
+
+const export_index::shard &export_index::get_shard(llvm::StringRef usr) const {
+  return shards_[llvm::xxh3_64bits(usr) % kShards];
+}
+
+void export_index::insert(llvm::StringRef usr, decision state) {
+  shard &bucket = get_shard(usr);
+  std::lock_guard<std::mutex> lock(bucket.mutex);
+  auto [entry, inserted] = bucket.usrs.try_emplace(usr, state);
+  if (!inserted && state == decision::applied)
+    entry->second = state;
+}
+
+bool export_index::insert(llvm::StringRef usr) {
+  if (base_ && base_->contains(usr))
+    return false;
+
+  shard &bucket = get_shard(usr);
+  std::lock_guard<std::mutex> lock(bucket.mutex);
+  return bucket.usrs
+      .try_emplace(usr, applies_ ? decision::applied : decision::reported)
+      .second;
+}
+
+bool export_index::contains(llvm::StringRef usr) const {
+  if (base_ && base_->contains(usr))
+    return true;
+
+  const shard &bucket = get_shard(usr);
+  std::lock_guard<std::mutex> lock(bucket.mutex);
+  return bucket.usrs.contains(usr);
+}
+
+std::size_t export_index::size() const {
+  std::size_t size = 0;
+  for (const shard &bucket : shards_) {
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    size += bucket.usrs.size();
+  }
+  return size;
+}
+
+void export_index::merge(const export_index &other) {
+  for (const shard &bucket : other.shards_) {
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    for (const auto &usr : bucket.usrs)
+      insert(usr.getKey(), usr.getValue());
+  }
+}
+
+llvm::Error export_index::load(llvm::StringRef path) {
+  if (!llvm::sys::fs::exists(path))
+    return llvm::Error::success();
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/true);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(), "unable to read '%s': %s",
+                                   path.str().c_str(),
+                                   buffer.getError().message().c_str());
+
+  llvm::SmallVector<llvm::StringRef, 0> lines;
+  (*buffer)->getBuffer().split(lines, '\n', /*MaxSplit=*/-1,
+                               /*KeepEmpty=*/false);
+  for (llvm::StringRef line : lines) {
+    auto [state, usr] = line.rtrim().split(' ');
+    if (usr.empty())
+      continue;
+    if (state == "applied")
+      insert(usr, decision::applied);
+    else if (state == "reported" && !applies_)
+      insert(usr, decision::reported);
+  }
+  return llvm::Error::success();
+}
+
+llvm::Error export_index::save(llvm::StringRef path) const {
+  std::vector<std::pair<std::string, decision>> usrs;
+  for (const shard &bucket : shards_) {
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    for (const auto &usr : bucket.usrs)
+      usrs.emplace_back(usr.getKey().str(), usr.getValue());
+  }
+  std::sort(usrs.begin(), usrs.end());
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Text);
+  if (ec)
+    return llvm::createStringError(ec, "unable to write '%s': %s",
+                                   path.str().c_str(), ec.message().c_str());
+
+  for (const auto &usr : usrs)
+    os << (usr.second == decision::applied ? "applied " : "reported ")
+       << usr.first << '\n';
+  return llvm::Error::success();
+}
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/file_cache.hh"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Path.h"
+
+namespace {
+// A file whose contents are owned by the cache.
+class cached_file : public llvm::vfs::File {
+  llvm::vfs::Status status_;
+  const llvm::MemoryBuffer &buffer_;
+
+public:
+  cached_file(llvm::vfs::Status status, const llvm::MemoryBuffer &buffer)
+      : status_(std::move(status)), buffer_(buffer) {}
+
+  llvm::ErrorOr<llvm::vfs::Status> status() override { return status_; }
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+  getBuffer(const llvm::Twine &name, int64_t, bool RequiresNullTerminator,
+            bool) override {
+    return llvm::MemoryBuffer::getMemBuffer(buffer_.getMemBufferRef(),
+                                            RequiresNullTerminator);
+  }
+
+  std::error_code close() override { return {}; }
+};
+}
+
+namespace idt {
+const file_cache::entry *file_cache::find(llvm::StringRef path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto cached = entries_.find(path);
+  return cached == entries_.end() ? nullptr : &cached->second;
+}
+
+llvm::ErrorOr<const file_cache::entry *>
+file_cache::get(llvm::vfs::FileSystem &fs, llvm::StringRef path) {
+  if (const entry *cached = find(path))
+    return cached;
+
+  // The file is read without holding the lock; if another analysis reads it
+  // concurrently, the first copy to be cached is used.
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> file =
+      fs.openFileForRead(path);
+  if (!file)
+    return file.getError();
+
+  llvm::ErrorOr<llvm::vfs::Status> status = (*file)->status();
+  if (!status)
+    return status.getError();
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      (*file)->getBuffer(path);
+  if (!buffer)
+    return buffer.getError();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return &entries_
+              .try_emplace(path, entry{std::move(*status), std::move(*buffer)})
+              .first->second;
+}
+
+const llvm::MemoryBuffer *file_cache::prefetch(llvm::vfs::FileSystem &fs,
+                                               llvm::StringRef path) {
+  llvm::ErrorOr<const entry *> cached = get(fs, path);
+  return cached ? (*cached)->buffer.get() : nullptr;
+}
+
+void file_cache::invalidate(llvm::StringRef path) {
+  // The keys retain any `..` components of the paths which were read, which
+  // the path need not.
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto entry = entries_.begin(), end = entries_.end(); entry != end;) {
+    llvm::SmallString<256> name{entry->first()};
+    llvm::sys::path::remove_dots(name, /*remove_dot_dot=*/true);
+    auto current = entry++;
+    if (name == path)
+      entries_.erase(current);
+  }
+}
+
+llvm::ErrorOr<llvm::vfs::Status>
+cached_file_system::status(const llvm::Twine &path) {
+  llvm::SmallString<256> name;
+  path.toVector(name);
+  if (!makeAbsolute(name)) {
+    llvm::sys::path::remove_dots(name);
+    if (const file_cache::entry *cached = cache_.find(name))
+      return llvm::vfs::Status::copyWithNewName(cached->status, path.str());
+  }
+  return getUnderlyingFS().status(path);
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+cached_file_system::openFileForRead(const llvm::Twine &path) {
+  llvm::SmallString<256> name;
+  path.toVector(name);
+  if (std::error_code ec = makeAbsolute(name))
+    return ec;
+  llvm::sys::path::remove_dots(name);
+
+  llvm::ErrorOr<const file_cache::entry *> cached =
+      cache_.get(getUnderlyingFS(), name);
+  if (!cached)
+    return cached.getError();
+  return std::make_unique<cached_file>(
+      llvm::vfs::Status::copyWithNewName((*cached)->status, path.str()),
+      *(*cached)->buffer);
+}
+}
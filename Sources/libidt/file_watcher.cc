@@ -0,0 +1,33 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/file_watcher.hh"
+
+#include "llvm/Support/FileSystem.h"
+
+namespace idt {
+file_watcher::state file_watcher::get_state(llvm::StringRef path) {
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(path, status))
+    return state{false, {}, 0};
+  return state{true, status.getLastModificationTime(), status.getSize()};
+}
+
+void file_watcher::watch(llvm::StringRef path) {
+  auto [entry, inserted] = files_.try_emplace(path.str());
+  if (inserted)
+    entry->second = get_state(path);
+}
+
+std::vector<std::string> file_watcher::poll() {
+  std::vector<std::string> changed;
+  for (auto &entry : files_) {
+    state current = get_state(entry.first);
+    if (current == entry.second)
+      continue;
+    entry.second = current;
+    changed.push_back(entry.first);
+  }
+  return changed;
+}
+}
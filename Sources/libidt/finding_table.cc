@@ -0,0 +1,82 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/finding_table.hh"
+
+#include <algorithm>
+
+namespace idt {
+unsigned finding_table::intern(llvm::StringRef string) {
+  auto [entry, inserted] =
+      ids_.try_emplace(string, static_cast<unsigned>(strings_.size()));
+  if (inserted)
+    strings_.push_back(entry->first());
+  return entry->second;
+}
+
+bool finding_table::insert(const row &entry) {
+  auto [existing, inserted] = index_.try_emplace(
+      key{entry.kind, entry.file, entry.offset, entry.name},
+      static_cast<unsigned>(rows_.size()));
+  if (inserted)
+    rows_.push_back(entry);
+  return inserted;
+}
+
+void finding_table::merge(const finding_table &other) {
+  // The strings of the other table are interned once each, rather than once
+  // for each row which refers to them.
+  std::vector<unsigned> ids;
+  ids.reserve(other.strings_.size());
+  for (llvm::StringRef string : other.strings_)
+    ids.push_back(intern(string));
+
+  for (row entry : other.rows_) {
+    entry.file = ids[entry.file];
+    entry.name = ids[entry.name];
+    entry.scope = ids[entry.scope];
+    entry.record = ids[entry.record];
+    insert(entry);
+  }
+}
+
+std::vector<const finding_table::row *> finding_table::sorted() const {
+  // Rank the files by name once, rather than comparing the names for each
+  // pair of rows.
+  std::vector<unsigned> files;
+  for (const row &entry : rows_)
+    files.push_back(entry.file);
+  std::sort(files.begin(), files.end());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+  std::sort(files.begin(), files.end(), [this](unsigned lhs, unsigned rhs) {
+    return strings_[lhs] < strings_[rhs];
+  });
+
+  std::vector<unsigned> ranks(strings_.size());
+  for (unsigned rank = 0; rank < files.size(); ++rank)
+    ranks[files[rank]] = rank;
+
+  std::vector<const row *> result;
+  result.reserve(rows_.size());
+  for (const row &entry : rows_)
+    result.push_back(&entry);
+  std::sort(result.begin(), result.end(),
+            [&](const row *lhs, const row *rhs) {
+              if (lhs->file != rhs->file)
+                return ranks[lhs->file] < ranks[rhs->file];
+              if (lhs->offset != rhs->offset)
+                return lhs->offset < rhs->offset;
+              if (lhs->kind != rhs->kind)
+                return lhs->kind < rhs->kind;
+              return strings_[lhs->name] < strings_[rhs->name];
+            });
+  return result;
+}
+
+std::size_t finding_table::memory() const {
+  return ids_.getAllocator().getTotalMemory() +
+         ids_.getNumBuckets() * (sizeof(void *) + sizeof(unsigned)) +
+         strings_.capacity() * sizeof(llvm::StringRef) +
+         rows_.capacity() * sizeof(row) + index_.getMemorySize();
+}
+}
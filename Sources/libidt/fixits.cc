@@ -0,0 +1,118 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/fixits.hh"
+
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <system_error>
+
+namespace idt {
+void fixit_set::insert(llvm::StringRef file, unsigned offset,
+                       const edit &change) {
+  auto [existing, inserted] = edits_[file.str()].try_emplace(offset, change);
+  if (!inserted && (existing->second.length != change.length ||
+                    existing->second.text != change.text))
+    ++conflicts_;
+}
+
+void fixit_set::add(const clang::SourceManager &source_manager,
+                    const clang::LangOptions &language_options,
+                    const clang::FixItHint &hint) {
+  if (hint.isNull())
+    return;
+
+  // As with the rewriter, a hint within a macro expansion is only applied if
+  // it is at the start or end of the expansion.
+  const clang::CharSourceRange range = clang::Lexer::makeFileCharRange(
+      hint.RemoveRange, source_manager, language_options);
+  if (range.isInvalid())
+    return;
+
+  const auto [id, offset] = source_manager.getDecomposedLoc(range.getBegin());
+  const unsigned end = source_manager.getFileOffset(range.getEnd());
+  const auto entry = source_manager.getFileEntryRefForID(id);
+  if (!entry || end < offset)
+    return;
+
+  // The same header may be reached through different relative paths.
+  llvm::SmallString<256> file{entry->getName()};
+  source_manager.getFileManager().makeAbsolutePath(file);
+  llvm::sys::path::remove_dots(file);
+
+  insert(file, offset,
+         edit{end - offset, source_manager.getLineNumber(id, offset),
+              source_manager.getColumnNumber(id, offset),
+              source_manager.getLineNumber(id, end),
+              source_manager.getColumnNumber(id, end),
+              hint.CodeToInsert});
+}
+
+void fixit_set::merge(const fixit_set &other) {
+  for (const auto &file : other.edits_)
+    for (const auto &change : file.second)
+      insert(file.first, change.first, change.second);
+  conflicts_ += other.conflicts_;
+}
+
+std::size_t fixit_set::size() const {
+  std::size_t size = 0;
+  for (const auto &file : edits_)
+    size += file.second.size();
+  return size;
+}
+
+void fixit_set::print(llvm::raw_ostream &os) const {
+  for (const auto &file : edits_)
+    for (const auto &change : file.second) {
+      const edit &value = change.second;
+      os << "fix-it:\"";
+      os.write_escaped(file.first);
+      os << "\":{" << value.line << ':' << value.column << '-'
+         << value.end_line << ':' << value.end_column << "}:\"";
+      os.write_escaped(value.text);
+      os << "\"\n";
+    }
+}
+
+llvm::Error fixit_set::apply() const {
+  for (const auto &file : edits_) {
+    const std::string &path = file.first;
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+        llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                    /*RequiresNullTerminator=*/false);
+    if (!buffer)
+      return llvm::createStringError(buffer.getError(),
+                                     "unable to read '%s': %s", path.c_str(),
+                                     buffer.getError().message().c_str());
+
+    // The edits are ordered by offset; an edit which overlaps the range
+    // replaced by the previous one is dropped.
+    const llvm::StringRef contents = (*buffer)->getBuffer();
+    std::string result;
+    std::size_t position = 0;
+    for (const auto &change : file.second) {
+      const unsigned offset = change.first;
+      if (offset < position || offset + change.second.length > contents.size())
+        continue;
+      result.append(contents.data() + position, offset - position);
+      result.append(change.second.text);
+      position = offset + change.second.length;
+    }
+    result.append(contents.data() + position, contents.size() - position);
+    buffer->reset();
+
+    std::error_code ec;
+    llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_None);
+    if (ec)
+      return llvm::createStringError(ec, "unable to write '%s': %s",
+                                     path.c_str(), ec.message().c_str());
+    os << result;
+  }
+  return llvm::Error::success();
+}
+}
@@ -0,0 +1,1833 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/idt.hh"
+
+#include "clang/AST/Mangle.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Index/USRGeneration.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/GlobPattern.h"
+#include "llvm/Support/Regex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+// TODO(compnerd) make this configurable via a configuration file or commandline
+const std::set<std::string> kIgnoredBuiltins{
+  "_BitScanForward",
+  "_BitScanForward64",
+  "_BitScanReverse",
+  "_BitScanReverse64",
+  "__builtin_strlen",
+};
+
+template <typename Key, typename Compare, typename Allocator>
+bool contains(const std::set<Key, Compare, Allocator>& set, const Key& key) {
+  return set.find(key) != set.end();
+}
+
+// Returns the export annotation written on the declaration itself, as opposed
+// to one inherited from a previous declaration or from the enclosing class.
+const clang::Attr *get_explicit_export_attr(const clang::Decl *D) {
+  for (const clang::Attr *A : D->attrs()) {
+    if (A->isInherited() || A->isImplicit())
+      continue;
+
+    if (llvm::isa<clang::DLLExportAttr>(A) ||
+        llvm::isa<clang::DLLImportAttr>(A))
+      return A;
+
+    if (const auto *VA = llvm::dyn_cast<clang::VisibilityAttr>(A))
+      if (VA->getVisibility() == clang::VisibilityAttr::VisibilityType::Default)
+        return A;
+  }
+  return nullptr;
+}
+
+// Determine if the results of the configurations of the sources are compared
+// and merged.
+bool merges_configurations(const idt::options &options) {
+  return options.configurations.size() > 1;
+}
+
+// Determine if the declarations which are already exported are recorded as
+// findings, for the reports which cover the whole of the exported interface.
+bool records_exported_interfaces(const idt::options &options) {
+  return options.export_report ||
+         options.symbol_file != idt::symbol_file_format::none ||
+         options.snapshot || options.findings ||
+         merges_configurations(options);
+}
+
+// Estimate the number of symbols which exporting the declaration adds to the
+// dynamic symbol table. Exporting a class exports all of its members,
+// including the implicitly declared special members, and its vtable and type
+// information if it is polymorphic.
+unsigned estimate_exported_symbols(const clang::NamedDecl *D) {
+  const auto *RD = llvm::dyn_cast<clang::CXXRecordDecl>(D);
+  if (!RD)
+    return 1;
+
+  if (!RD->hasDefinition())
+    return 0;
+  RD = RD->getDefinition();
+
+  unsigned symbols = 0;
+  for (const clang::CXXMethodDecl *MD : RD->methods())
+    if (!(MD->isDeleted() || MD->isPureVirtual()))
+      ++symbols;
+
+  for (const clang::Decl *member : RD->decls())
+    if (const auto *VD = llvm::dyn_cast<clang::VarDecl>(member))
+      if (VD->isStaticDataMember())
+        ++symbols;
+
+  symbols += RD->needsImplicitDefaultConstructor() +
+             RD->needsImplicitCopyConstructor() +
+             RD->needsImplicitMoveConstructor() +
+             RD->needsImplicitCopyAssignment() +
+             RD->needsImplicitMoveAssignment() +
+             RD->needsImplicitDestructor();
+
+  // The vtable, the type information and the type name.
+  if (RD->isDynamicClass())
+    symbols += 3;
+
+  return symbols;
+}
+
+// Estimate the number of symbols exported if the members of a class are
+// exported individually rather than at the class level. Only the members which
+// are defined out-of-line need to be exported.
+unsigned estimate_member_exported_symbols(const clang::CXXRecordDecl *RD) {
+  if (!RD->hasDefinition())
+    return 0;
+  RD = RD->getDefinition();
+
+  unsigned symbols = 0;
+  for (const clang::CXXMethodDecl *MD : RD->methods())
+    if (!(MD->isImplicit() || MD->isInlined() || MD->isDeleted() ||
+          MD->isDefaulted() || MD->isPureVirtual()))
+      ++symbols;
+
+  for (const clang::Decl *member : RD->decls())
+    if (const auto *VD = llvm::dyn_cast<clang::VarDecl>(member))
+      if (VD->isStaticDataMember() && !VD->isInline())
+        ++symbols;
+
+  return symbols;
+}
+
+// The namespace enclosing the declaration.
+std::string get_enclosing_namespace(const clang::Decl *D) {
+  for (const clang::DeclContext *DC = D->getDeclContext(); DC;
+       DC = DC->getParent())
+    if (const auto *ND = llvm::dyn_cast<clang::NamespaceDecl>(DC))
+      return ND->getQualifiedNameAsString();
+  return "(global namespace)";
+}
+
+// The class which the declaration is a member of, or the class itself.
+std::string get_enclosing_record(const clang::NamedDecl *D) {
+  if (const auto *RD = llvm::dyn_cast<clang::CXXRecordDecl>(D))
+    return RD->getQualifiedNameAsString();
+  if (const auto *RD = llvm::dyn_cast<clang::CXXRecordDecl>(D->getDeclContext()))
+    return RD->getQualifiedNameAsString();
+  return {};
+}
+
+// Add the mangled names of the symbols which exporting the declaration
+// exports, mapped to whether they name data rather than code. The names are
+// mangled for the ABI of the target of the translation unit. Exporting a class
+// exports its members which are defined out-of-line, and its vtable and type
+// information if it is polymorphic.
+void mangle_exported_symbols(clang::MangleContext &mangler,
+                             const clang::NamedDecl *D,
+                             std::map<std::string, bool> &symbols) {
+  const bool itanium = llvm::isa<clang::ItaniumMangleContext>(mangler);
+
+  auto add = [&mangler, &symbols](clang::GlobalDecl GD, bool data) {
+    const auto *ND = llvm::cast<clang::NamedDecl>(GD.getDecl());
+    std::string name;
+    llvm::raw_string_ostream os(name);
+    if (mangler.shouldMangleDeclName(ND))
+      mangler.mangleName(GD, os);
+    else
+      os << ND->getName();
+    symbols.emplace(std::move(os.str()), data);
+  };
+
+  auto add_function = [&](const clang::FunctionDecl *FD) {
+    if (const auto *CD = llvm::dyn_cast<clang::CXXConstructorDecl>(FD)) {
+      add(clang::GlobalDecl(CD, clang::Ctor_Complete), false);
+      if (itanium)
+        add(clang::GlobalDecl(CD, clang::Ctor_Base), false);
+    } else if (const auto *DD = llvm::dyn_cast<clang::CXXDestructorDecl>(FD)) {
+      add(clang::GlobalDecl(DD, clang::Dtor_Base), false);
+      if (itanium) {
+        add(clang::GlobalDecl(DD, clang::Dtor_Complete), false);
+        if (DD->isVirtual())
+          add(clang::GlobalDecl(DD, clang::Dtor_Deleting), false);
+      }
+    } else {
+      add(clang::GlobalDecl(FD), false);
+    }
+  };
+
+  if (const auto *FD = llvm::dyn_cast<clang::FunctionDecl>(D))
+    return add_function(FD);
+
+  if (const auto *VD = llvm::dyn_cast<clang::VarDecl>(D))
+    return add(clang::GlobalDecl(VD), true);
+
+  const auto *RD = llvm::dyn_cast<clang::CXXRecordDecl>(D);
+  if (!RD || !RD->hasDefinition())
+    return;
+  RD = RD->getDefinition();
+
+  for (const clang::CXXMethodDecl *MD : RD->methods())
+    if (!(MD->isImplicit() || MD->isInlined() || MD->isDeleted() ||
+          MD->isDefaulted() || MD->isPureVirtual()))
+      add_function(MD);
+
+  for (const clang::Decl *member : RD->decls())
+    if (const auto *VD = llvm::dyn_cast<clang::VarDecl>(member))
+      if (VD->isStaticDataMember() && !VD->isInline())
+        add(clang::GlobalDecl(VD), true);
+
+  if (!RD->isDynamicClass())
+    return;
+
+  std::string name;
+  llvm::raw_string_ostream os(name);
+  auto flush = [&name, &os, &symbols]() {
+    symbols.emplace(std::move(os.str()), true);
+    name.clear();
+  };
+
+  const clang::QualType type = RD->getASTContext().getRecordType(RD);
+  if (auto *IMC = llvm::dyn_cast<clang::ItaniumMangleContext>(&mangler)) {
+    IMC->mangleCXXVTable(RD, os);
+    flush();
+    IMC->mangleCXXRTTI(type, os);
+    flush();
+    IMC->mangleCXXRTTIName(type, os);
+    flush();
+  } else if (auto *MMC =
+                 llvm::dyn_cast<clang::MicrosoftMangleContext>(&mangler)) {
+    MMC->mangleCXXVFTable(RD, {}, os);
+    flush();
+  }
+}
+}
+
+namespace idt {
+bool is_glob(llvm::StringRef pattern) {
+  return pattern.find_first_of("*?[{") != llvm::StringRef::npos;
+}
+
+bool requires_includes(const options &options) {
+  return !options.include_header.empty() ||
+         std::any_of(options.components.begin(), options.components.end(),
+                     [](const component &entry) {
+                       return !entry.include_header.empty();
+                     });
+}
+
+void PPCallbacks::InclusionDirective(
+    clang::SourceLocation HashLoc, const clang::Token &IncludeTok,
+    clang::StringRef FileName, bool IsAngled,
+    clang::CharSourceRange FilenameRange, clang::OptionalFileEntryRef File,
+    clang::StringRef SearchPath, clang::StringRef RelativePath,
+    const clang::Module *SuggestedModule, bool ModuleImported,
+    clang::SrcMgr::CharacteristicKind FileType) {
+  // The includes which are translated into the import of a module are also
+  // tracked, as the directive is still written in the file.
+
+  // Track the name and location of each include in the order discovered.
+  clang::SourceLocation SLoc = source_manager_.getSpellingLoc(HashLoc);
+
+  // Get the name of the file that contains the #include statement. This
+  // string is distinct from the FileName function parameter, which is the
+  // name of the include target (e.g. #include <FileName>).
+  std::string containingFileName = source_manager_.getFilename(SLoc).str();
+
+  // Only add the include to the list if it isn't already present.
+  auto &includes = file_includes_[containingFileName];
+  if (std::none_of(includes.begin(), includes.end(),
+                   [&FileName](const IncludeLocation &include) {
+                     return std::get<0>(include) == FileName.str();
+                   }))
+    includes.emplace_back(FileName.str(), SLoc);
+}
+
+// Track a set of clang::Decl declarations by unique ID.
+class DeclSet {
+  llvm::SmallPtrSet<std::uintptr_t, 32> decls_;
+
+  // Use pointer identity of the canonical declaration object as a unique ID.
+  template <typename Decl_>
+  std::uintptr_t decl_id(const Decl_ *D) const {
+    return reinterpret_cast<std::uintptr_t>(D->getCanonicalDecl());
+  }
+
+public:
+  template <typename Decl_>
+  inline void insert(const Decl_ *D) {
+    decls_.insert(decl_id(D));
+  }
+
+  template <typename Decl_>
+  inline bool contains(const Decl_ *D) const {
+    return decls_.find(decl_id(D)) != decls_.end();
+  }
+};
+
+class visitor : public clang::RecursiveASTVisitor<visitor> {
+  clang::ASTContext &context_;
+  clang::SourceManager &source_manager_;
+  const idt::options &options_;
+  const PPCallbacks::FileIncludes &file_includes_;
+
+  // The declarations decided to be exported across the run, if any.
+  export_index *index_;
+
+  // Called as each declaration is visited, if set.
+  llvm::function_ref<void()> progress_;
+
+  // The findings of the analysis, in the order they are discovered.
+  std::vector<finding> findings_;
+
+  // The files to which the include for the export macro has been added.
+  std::set<std::string> files_with_added_include_;
+
+  // Accumulates the set of declarations that have been marked for export by
+  // this visitor.
+  DeclSet exported_decls_;
+
+  // The class definitions whose export at the class level has been decided.
+  DeclSet settled_records_;
+
+  // The declarations which are explicitly annotated for export, in the order
+  // they are discovered, and the private members which are referenced from
+  // inline code in headers. These are only tracked when reporting exported
+  // declarations which are not part of the public interface or the number of
+  // exported symbols.
+  std::vector<const clang::NamedDecl *> annotated_decls_;
+  DeclSet annotated_decl_set_;
+  DeclSet referenced_from_headers_;
+
+  std::vector<llvm::Regex> private_headers_;
+  std::optional<llvm::Regex> header_filter_;
+
+  // The components, in order, with the glob matching their headers if the
+  // pattern is not a path prefix, and the component of the headers which
+  // match none of them, which has no export macro if there is none.
+  std::vector<std::pair<const component *, std::optional<llvm::GlobPattern>>>
+      components_;
+  component default_component_;
+
+  // The component of each file, if any, cached by FileID.
+  mutable llvm::DenseMap<clang::FileID, const component *> file_components_;
+
+  // The classification of each file, as a set of `file_class` flags, the
+  // innermost class enclosing the declarations in each context, and the export
+  // status of each such class. The status of a class is updated when it is
+  // exported, so none of them are invalidated.
+  enum file_class : unsigned {
+    kHeader = 1 << 0,
+    kSystemHeader = 1 << 1,
+    kPrivateHeader = 1 << 2,
+    // A header which does not match `--header-filter`. It is still a header,
+    // but the declarations in it are not annotated.
+    kFilteredHeader = 1 << 3,
+  };
+  mutable llvm::DenseMap<clang::FileID, unsigned> file_classes_;
+  mutable llvm::DenseMap<const clang::DeclContext *, const clang::RecordDecl *>
+      context_records_;
+  mutable llvm::DenseMap<const clang::RecordDecl *, bool> record_exported_;
+
+  mutable idt::statistics statistics_;
+
+  void add_missing_include(clang::SourceLocation location,
+                           const std::string &include_header) {
+    if (include_header.empty())
+      return;
+
+    clang::SourceLocation spellingLoc =
+        source_manager_.getSpellingLoc(location);
+    const std::string fileName = source_manager_.getFilename(spellingLoc).str();
+
+    // Only add the include once per file.
+    if (contains(files_with_added_include_, fileName))
+      return;
+
+    // TODO: if the modified file contains no existing include directives, we
+    // cannot currently determine where to insert the required include.
+    const auto entry = file_includes_.find(fileName);
+    if (entry == file_includes_.end() || entry->second.empty())
+      return;
+    const auto &includes = entry->second;
+
+    // Determine if the header is already included.
+    if (std::any_of(
+            includes.begin(), includes.end(),
+            [&include_header](const PPCallbacks::IncludeLocation &include) {
+              return std::get<0>(include) == include_header;
+            }))
+      return;
+
+    // Insert the new include at the start of the existing include list. Rely
+    // on clang-format to properly sort the include statements in alphabetical
+    // order.
+    clang::SourceLocation insertLoc =
+        source_manager_.getSpellingLoc(std::get<1>(includes.front()));
+
+    // Record the fix-it hint to add the include statement.
+    // TODO: consider using std::format after moving to C++20
+    std::string FixText = "#include \"" + include_header + "\"\n";
+    findings_.push_back({finding_kind::missing_include, nullptr, insertLoc,
+                         clang::FixItHint::CreateInsertion(insertLoc, FixText),
+                         include_header, 0});
+
+    // Remember the new include so we don't add it again.
+    files_with_added_include_.insert(fileName);
+  }
+
+  void unexported_public_interface(const clang::NamedDecl *D,
+                                   const component &owner,
+                                   clang::SourceLocation location,
+                                   clang::FixItHint fixit) {
+    if (rejects(predicate::not_targeted, D, [&] { return !is_targeted(D); })) {
+      findings_.push_back({finding_kind::untargeted_interface, D, location, {},
+                           {}, estimate_exported_symbols(D)});
+      return;
+    }
+
+    // Skip the declarations which have already been decided to be exported by
+    // another translation unit or by an earlier run. The USR is only computed
+    // for the declarations which require export, once per translation unit.
+    if (rejects(predicate::decided_elsewhere, D,
+                [&] { return index_ && !index_->insert(get_usr(D)); })) {
+      mark_exported(D);
+      return;
+    }
+
+    if (is_explained(D))
+      explain(D, "annotated with " + owner.export_macro);
+
+    add_missing_include(location, owner.include_header);
+
+    // Track every unexported declaration encountered. This information is used
+    // by is_symbol_exported to ensure a symbol does not get reported multiple
+    // times.
+    mark_exported(D);
+
+    findings_.push_back({finding_kind::unexported_public_interface, D, location,
+                         std::move(fixit), {}, estimate_exported_symbols(D)});
+  }
+
+  void mark_exported(const clang::NamedDecl *D) {
+    exported_decls_.insert(D);
+    if (const auto *RD = llvm::dyn_cast<clang::RecordDecl>(D))
+      record_exported_[RD] = true;
+  }
+
+  void exported_private_interface(const clang::NamedDecl *D,
+                                  clang::SourceLocation location,
+                                  clang::FixItHint fixit, std::string reason) {
+    findings_.push_back({finding_kind::exported_private_interface, D, location,
+                         std::move(fixit), std::move(reason),
+                         estimate_exported_symbols(D)});
+  }
+
+  std::string get_usr(const clang::NamedDecl *D) const {
+    llvm::SmallString<128> usr;
+    // A declaration without a USR is identified by its qualified name.
+    if (clang::index::generateUSRForDecl(D, usr))
+      return D->getQualifiedNameAsString();
+    return usr.str().str();
+  }
+
+  // Determine if the decisions about the declaration are explained, as it is
+  // named by `options.explain`.
+  bool is_explained(const clang::NamedDecl *D) const {
+    return !options_.explain.empty() &&
+           D->getQualifiedNameAsString() == options_.explain;
+  }
+
+  void explain(const clang::NamedDecl *D, std::string text) {
+    findings_.push_back({finding_kind::explanation, D, get_location(D), {},
+                         std::move(text), 0});
+  }
+
+  // Evaluate a predicate which rejects the declaration if it holds. The
+  // evaluations and rejections of each predicate are counted, and timed with
+  // `options.stats`, so that the statistics show which predicates prune the
+  // most. The outcome is explained for the declaration named by
+  // `options.explain`.
+  template <typename Predicate_>
+  bool rejects(predicate check, const clang::NamedDecl *D, Predicate_ test) {
+    const auto index = static_cast<std::size_t>(check);
+
+    bool rejected;
+    if (options_.stats) {
+      const auto start = std::chrono::steady_clock::now();
+      rejected = test();
+      statistics_.predicate_times[index] +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start);
+    } else {
+      rejected = test();
+    }
+
+    ++statistics_.evaluations[index];
+    if (rejected)
+      ++statistics_.rejections[index];
+
+    if (is_explained(D))
+      explain(D, std::string(get_description(check)) +
+                     (rejected ? ": yes, rejected" : ": no"));
+    return rejected;
+  }
+
+  // Determine if the declaration is one of the targeted symbols, or is a class
+  // with a targeted member.
+  bool is_targeted(const clang::NamedDecl *D) const {
+    const std::set<std::string> &targets = options_.target_symbols;
+    if (targets.empty())
+      return true;
+
+    const std::string name = D->getQualifiedNameAsString();
+    if (contains(targets, name))
+      return true;
+
+    if (!llvm::isa<clang::CXXRecordDecl>(D))
+      return false;
+
+    const std::string scope = name + "::";
+    const auto member = targets.lower_bound(scope);
+    return member != targets.end() &&
+           llvm::StringRef(*member).starts_with(scope);
+  }
+
+  template <typename Decl_>
+  inline clang::FullSourceLoc get_location(const Decl_ *TD) const {
+    return context_.getFullLoc(TD->getBeginLoc()).getExpansionLoc();
+  }
+
+  // Classify the file containing the location. The classification is cached
+  // by FileID, as the members of a class are usually declared in the same file
+  // and the name of the file would otherwise be matched for each of them.
+  unsigned classify(clang::SourceLocation location) const {
+    const clang::FileID id = source_manager_.getFileID(location);
+
+    ++statistics_.file_lookups;
+    const auto cached = file_classes_.find(id);
+    if (cached != file_classes_.end()) {
+      ++statistics_.file_hits;
+      return cached->second;
+    }
+
+    unsigned classes = 0;
+    if (source_manager_.isInSystemHeader(location))
+      classes |= kSystemHeader;
+
+    if (const auto entry = source_manager_.getFileEntryRefForID(id)) {
+      const llvm::StringRef name = entry->getName();
+      if (std::any_of(options_.header_extensions.begin(),
+                      options_.header_extensions.end(),
+                      [name](const std::string &extension) {
+                        return name.ends_with(extension);
+                      })) {
+        classes |= kHeader;
+        if (header_filter_ && !header_filter_->match(name)) {
+          classes |= kFilteredHeader;
+          ++statistics_.filtered_headers;
+        }
+      }
+
+      if (std::any_of(private_headers_.begin(), private_headers_.end(),
+                      [name](const llvm::Regex &pattern) {
+                        return pattern.match(name);
+                      }))
+        classes |= kPrivateHeader;
+    }
+
+    file_classes_.try_emplace(id, classes);
+    return classes;
+  }
+
+  // Determine the component owning the file containing the location, whose
+  // export macro the declarations in the file are annotated with. This is
+  // cached by FileID, as for the classification of the file.
+  const component *get_component(clang::SourceLocation location) const {
+    const clang::FileID id = source_manager_.getFileID(location);
+    const auto cached = file_components_.find(id);
+    if (cached != file_components_.end())
+      return cached->second;
+
+    const component *owner =
+        default_component_.export_macro.empty() ? nullptr : &default_component_;
+    if (const auto entry = source_manager_.getFileEntryRefForID(id)) {
+      const llvm::StringRef name = entry->getName();
+      const auto match = std::find_if(
+          components_.begin(), components_.end(),
+          [name](const auto &candidate) {
+            const std::optional<llvm::GlobPattern> &glob = candidate.second;
+            return glob ? glob->match(name)
+                        : name.starts_with(candidate.first->pattern);
+          });
+      if (match != components_.end())
+        owner = match->first;
+    }
+
+    file_components_.try_emplace(id, owner);
+    return owner;
+  }
+
+  template <typename Decl_>
+  inline bool is_in_header(const Decl_ *D) const {
+    return classify(get_location(D)) & kHeader;
+  }
+
+  // Determine if the declaration is in a header whose declarations may be
+  // annotated, which excludes the headers not matching `--header-filter`.
+  template <typename Decl_>
+  inline bool is_in_annotated_header(const Decl_ *D) const {
+    return (classify(get_location(D)) & (kHeader | kFilteredHeader)) ==
+           kHeader;
+  }
+
+  template <typename Decl_>
+  inline bool is_in_system_header(const Decl_ *D) const {
+    return classify(get_location(D)) & kSystemHeader;
+  }
+
+  template <typename Decl_>
+  inline bool is_in_private_header(const Decl_ *D) const {
+    return classify(get_location(D)) & kPrivateHeader;
+  }
+
+  // Determine if the declaration is within an anonymous namespace or within a
+  // namespace which contains implementation details by convention.
+  bool is_in_internal_namespace(const clang::Decl *D) const {
+    for (const clang::DeclContext *DC = D->getDeclContext(); DC;
+         DC = DC->getParent())
+      if (const auto *ND = llvm::dyn_cast<clang::NamespaceDecl>(DC))
+        if (ND->isAnonymousNamespace() ||
+            contains(options_.internal_namespaces, ND->getName().str()))
+          return true;
+    return false;
+  }
+
+  // Track the declarations which are explicitly annotated for export so that
+  // they can be checked once the whole translation unit has been visited.
+  void record_annotated_decl(const clang::NamedDecl *D) {
+    if (!(options_.over_exports || records_exported_interfaces(options_)))
+      return;
+
+    if (D->isTemplated() || is_in_system_header(D))
+      return;
+
+    if (annotated_decl_set_.contains(D) || !get_explicit_export_attr(D))
+      return;
+
+    annotated_decl_set_.insert(D);
+    annotated_decls_.push_back(D);
+  }
+
+  // Track the private members which are referenced from inline code in
+  // headers, as these must remain exported.
+  template <typename Expr_>
+  void record_private_reference(const Expr_ *E, const clang::NamedDecl *D) {
+    if (options_.over_exports && is_in_header(E))
+      referenced_from_headers_.insert(D);
+  }
+
+  // Determine why a declaration which is explicitly annotated for export is
+  // not part of the public interface, if it is not.
+  const char *get_over_export_reason(const clang::NamedDecl *D) const {
+    if (is_in_internal_namespace(D))
+      return "declared in an internal namespace";
+
+    if (!is_in_header(D) || is_in_private_header(D))
+      return "declared outside of the public headers";
+
+    if (const auto *FD = llvm::dyn_cast<clang::FunctionDecl>(D))
+      if (FD->isInlined())
+        return "inline function";
+
+    if (D->getAccess() == clang::AccessSpecifier::AS_private &&
+        !referenced_from_headers_.contains(D))
+      return "private member not referenced from inline code";
+
+    return nullptr;
+  }
+
+  // Suggest removing the export annotation if it is spelt with the export
+  // macro of the component containing it.
+  clang::FixItHint remove_export_macro(const clang::Attr *A) const {
+    const clang::SourceLocation location = A->getLocation();
+    if (!location.isMacroID())
+      return {};
+
+    const clang::CharSourceRange range =
+        source_manager_.getExpansionRange(location);
+    const component *owner = get_component(range.getBegin());
+    if (!owner)
+      return {};
+
+    const llvm::StringRef text = clang::Lexer::getSourceText(
+        range, source_manager_, context_.getLangOpts());
+    if (text != owner->export_macro)
+      return {};
+
+    return clang::FixItHint::CreateRemoval(range);
+  }
+
+  template <typename Decl_>
+  bool is_symbol_exported(const Decl_ *D) const {
+    // Check the set of symbols we've already marked for export.
+    if (exported_decls_.contains(D))
+      return true;
+
+    // Check if the symbol is annotated with __declspec(dllimport) or
+    // __declspec(dllexport).
+    if (D->template hasAttr<clang::DLLExportAttr>() ||
+        D->template hasAttr<clang::DLLImportAttr>())
+      return true;
+
+    // Check if the symbol is annotated with [[gnu::visibility("default")]]
+    // or the equivalent __attribute__((visibility("default")))
+    if (const auto *VA = D->template getAttr<clang::VisibilityAttr>())
+      return VA->getVisibility() == clang::VisibilityAttr::VisibilityType::Default;
+
+    if (llvm::isa<clang::RecordDecl>(D))
+      return false;
+
+    return is_context_exported(D->getDeclContext());
+  }
+
+  // For non-record declarations, the export status is that of the innermost
+  // enclosing record, which is shared by all of the declarations in the
+  // context.
+  bool is_context_exported(const clang::DeclContext *context) const {
+    ++statistics_.context_lookups;
+    auto [entry, inserted] = context_records_.try_emplace(context, nullptr);
+    if (inserted)
+      for (const clang::DeclContext *DC = context; DC; DC = DC->getParent())
+        if (const auto *RD = llvm::dyn_cast<clang::RecordDecl>(DC)) {
+          entry->second = RD;
+          break;
+        }
+
+    const clang::RecordDecl *record = entry->second;
+    if (!record)
+      return false;
+
+    const auto cached = record_exported_.find(record);
+    if (cached != record_exported_.end()) {
+      ++statistics_.context_hits;
+      return cached->second;
+    }
+
+    const bool exported = is_symbol_exported(record);
+    record_exported_.try_emplace(record, exported);
+    return exported;
+  }
+
+  // Determine if the method has a definition which the clients of its class
+  // can see, when deciding whether the class is exported. A definition in the
+  // source being analyzed of a method declared in a header cannot be seen by
+  // them; considering it would make the class be exported or not depending on
+  // which source is analyzed, and its members with it.
+  bool has_visible_definition(const clang::CXXMethodDecl *MD) const {
+    const clang::FunctionDecl *definition = nullptr;
+    if (!MD->hasBody(definition))
+      return false;
+
+    const clang::FileID main = source_manager_.getMainFileID();
+    return source_manager_.getFileID(get_location(definition)) != main ||
+           source_manager_.getFileID(get_location(MD)) == main;
+  }
+
+  // Decide whether the class enclosing a member is exported before the member
+  // itself, so that a member is not annotated when its class is. This is
+  // usually the order in which they are visited, but the private members
+  // referenced from inline code may be visited first.
+  void settle_enclosing_record(const clang::Decl *D) {
+    // Implicit instantiations are never annotated.
+    if (const auto *RD =
+            llvm::dyn_cast<clang::CXXRecordDecl>(D->getDeclContext()))
+      if (!RD->getTemplateInstantiationPattern())
+        export_record_if_needed(RD);
+  }
+
+  // Determine if a function needs exporting and add the export annotation as
+  // required.
+  void export_function_if_needed(const clang::FunctionDecl *FD) {
+    settle_enclosing_record(FD);
+
+    // Check if the symbol is already exported.
+    if (rejects(predicate::already_exported, FD,
+                [&] { return is_symbol_exported(FD); }))
+      return;
+
+    // Ignore declarations from the system.
+    if (rejects(predicate::system_header, FD,
+                [&] { return is_in_system_header(FD); }))
+      return;
+
+    // Skip declarations not in header files.
+    if (rejects(predicate::not_header, FD,
+                [&] { return !is_in_annotated_header(FD); }))
+      return;
+
+    // We are only interested in non-dependent types.
+    if (rejects(predicate::dependent_context, FD,
+                [&] { return FD->isDependentContext(); }))
+      return;
+
+    // If the function has a body, it can be materialized by the user.
+    if (rejects(predicate::visible_definition, FD,
+                [&] { return FD->hasBody(); }))
+      return;
+
+    // Skip methods in template declarations.
+    if (rejects(predicate::instantiation, FD, [&] {
+          return FD->getTemplateInstantiationPattern() != nullptr;
+        }))
+      return;
+
+    // Ignore friend declarations.
+    if (rejects(predicate::friend_declaration, FD, [&] {
+          return FD->getFriendObjectKind() != clang::Decl::FOK_None;
+        }))
+      return;
+
+    // Ignore deleted and defaulted functions (e.g. operators).
+    if (rejects(predicate::deleted_or_defaulted, FD,
+                [&] { return FD->isDeleted() || FD->isDefaulted(); }))
+      return;
+
+    // Skip template class template argument deductions.
+    if (rejects(predicate::deduction_guide, FD, [&] {
+          return llvm::isa<clang::CXXDeductionGuideDecl>(FD);
+        }))
+      return;
+
+    // Pure virtual methods cannot be exported.
+    if (rejects(predicate::pure_virtual, FD, [&] {
+          const auto *MD = llvm::dyn_cast<clang::CXXMethodDecl>(FD);
+          return MD && MD->isPureVirtual();
+        }))
+      return;
+
+    // Ignore known forward declarations (builtins)
+    if (rejects(predicate::builtin, FD, [&] {
+          return contains(kIgnoredBuiltins, FD->getNameAsString());
+        }))
+      return;
+
+    // TODO(compnerd) replace with std::set::contains in C++20
+    if (rejects(predicate::ignored, FD, [&] {
+          return contains(options_.ignored_symbols, FD->getNameAsString());
+        }))
+      return;
+
+    // Headers which do not belong to a component are not annotated.
+    const component *owner = get_component(get_location(FD));
+    if (rejects(predicate::no_component, FD, [&] { return !owner; }))
+      return;
+
+    // Use the inner start location so that the annotation comes after
+    // any template information.
+    clang::SourceLocation SLoc = FD->getInnerLocStart();
+
+    // If the function declaration has any existing attributes, the export macro
+    // should be inserted after them. We can approximate this location using the
+    // function's return type location.
+    if (!FD->attrs().empty())
+      SLoc = FD->getTypeSourceInfo()->getTypeLoc().getBeginLoc();
+
+    unexported_public_interface(
+        FD, *owner, SLoc,
+        clang::FixItHint::CreateInsertion(SLoc, owner->export_macro + " "));
+  }
+
+  // Determine if a variable needs exporting and add the export annotation as
+  // required. This only applies to extern globals and static member fields.
+  void export_variable_if_needed(const clang::VarDecl *VD) {
+    settle_enclosing_record(VD);
+
+    // Check if the symbol is already exported.
+    if (rejects(predicate::already_exported, VD,
+                [&] { return is_symbol_exported(VD); }))
+      return;
+
+    // Ignore declarations from the system.
+    if (rejects(predicate::system_header, VD,
+                [&] { return is_in_system_header(VD); }))
+      return;
+
+    // Skip all variable declarations not in header files.
+    if (rejects(predicate::not_header, VD,
+                [&] { return !is_in_annotated_header(VD); }))
+      return;
+
+    // Skip local variables. We are only interested in static fields.
+    if (rejects(predicate::local_variable, VD,
+                [&] { return VD->getParentFunctionOrMethod() != nullptr; }))
+      return;
+
+    // Skip static fields that have initializers.
+    if (rejects(predicate::initialized, VD, [&] { return VD->hasInit(); }))
+      return;
+
+    // Skip all other local and global variables unless they are extern.
+    if (rejects(predicate::not_extern, VD, [&] {
+          return !(VD->isStaticDataMember() ||
+                   VD->getStorageClass() == clang::StorageClass::SC_Extern);
+        }))
+      return;
+
+    // Skip fields in template declarations.
+    if (rejects(predicate::instantiation, VD, [&] {
+          return VD->getTemplateInstantiationPattern() != nullptr;
+        }))
+      return;
+
+    // Skip static variables declared in template class unless the template is
+    // fully specialized.
+    if (rejects(predicate::class_template_member, VD, [&] {
+          const auto *RD =
+              llvm::dyn_cast<clang::CXXRecordDecl>(VD->getDeclContext());
+          if (!RD)
+            return false;
+          return RD->getDescribedClassTemplate() ||
+                 llvm::isa<clang::ClassTemplatePartialSpecializationDecl>(RD);
+        }))
+      return;
+
+    // TODO(compnerd) replace with std::set::contains in C++20
+    if (rejects(predicate::ignored, VD, [&] {
+          return contains(options_.ignored_symbols, VD->getNameAsString());
+        }))
+      return;
+
+    // Headers which do not belong to a component are not annotated.
+    const component *owner = get_component(get_location(VD));
+    if (rejects(predicate::no_component, VD, [&] { return !owner; }))
+      return;
+
+    clang::SourceLocation SLoc = VD->getBeginLoc();
+
+    // If the variable declaration has any existing attributes, the export macro
+    // should be inserted after them. Similarly, if the variable has external
+    // storage, the export macro should be inserted after the extern keyword. We
+    // can approximate this location using the variable's type location.
+    if (!VD->attrs().empty() || VD->hasExternalStorage())
+      SLoc = VD->getTypeSourceInfo()->getTypeLoc().getBeginLoc();
+
+    unexported_public_interface(
+        VD, *owner, SLoc,
+        clang::FixItHint::CreateInsertion(SLoc, owner->export_macro + " "));
+  }
+
+  // Determine if a tagged type needs exporting at the record level and add the
+  // export annotation as required.
+  void export_record_if_needed(const clang::CXXRecordDecl *RD) {
+    // Only the definition declares the methods, and it is decided once.
+    if (!RD->isThisDeclarationADefinition() || settled_records_.contains(RD))
+      return;
+    settled_records_.insert(RD);
+
+    // Check if the class is already exported.
+    if (rejects(predicate::already_exported, RD,
+                [&] { return is_symbol_exported(RD); }))
+      return;
+
+    // Ignore declarations from the system.
+    if (rejects(predicate::system_header, RD,
+                [&] { return is_in_system_header(RD); }))
+      return;
+
+    // Skip exporting template classes. For fully-specialized template classes,
+    // isTemplated() returns false so they will be annotated if needed.
+    if (rejects(predicate::templated, RD, [&] { return RD->isTemplated(); }))
+      return;
+
+    // If a class declaration contains an out-of-line virtual method, annotate
+    // the class instead of its individual members. This ensures its vtable is
+    // exported on non-Windows platforms. Do this regardless of the method's
+    // access level.
+    if (rejects(predicate::no_out_of_line_virtual_method, RD, [&] {
+          return std::none_of(
+              RD->method_begin(), RD->method_end(),
+              [this](const clang::CXXMethodDecl *MD) {
+                return !(MD->isPureVirtual() || MD->isDefaulted() ||
+                         MD->isDeleted()) &&
+                       (MD->isVirtual() && !has_visible_definition(MD));
+              });
+        }))
+      return;
+
+    // Insert the annotation immediately before the tag name, which is the
+    // position returned by getLocation.
+    clang::LangOptions LO = RD->getASTContext().getLangOpts();
+    clang::SourceLocation SLoc = RD->getQualifier()
+                                     ? RD->getQualifierLoc().getBeginLoc()
+                                     : RD->getLocation();
+    const clang::SourceLocation location =
+        context_.getFullLoc(SLoc).getExpansionLoc();
+
+    // Headers which do not belong to a component are not annotated.
+    const component *owner = get_component(location);
+    if (rejects(predicate::no_component, RD, [&] { return !owner; }))
+      return;
+
+    unexported_public_interface(
+        RD, *owner, location,
+        clang::FixItHint::CreateInsertion(SLoc, owner->export_macro + " "));
+  }
+
+public:
+  visitor(clang::ASTContext &context, const idt::options &options,
+          const PPCallbacks::FileIncludes &file_includes, export_index *index,
+          llvm::function_ref<void()> progress)
+      : context_(context), source_manager_(context.getSourceManager()),
+        options_(options), file_includes_(file_includes), index_(index),
+        progress_(progress) {
+    for (const auto &pattern : options_.private_headers)
+      private_headers_.emplace_back(pattern);
+    if (!options_.header_filter.empty())
+      header_filter_.emplace(options_.header_filter);
+
+    // The patterns are validated by the tool; an invalid glob matches nothing.
+    for (const auto &entry : options_.components) {
+      if (!is_glob(entry.pattern)) {
+        components_.emplace_back(&entry, std::nullopt);
+        continue;
+      }
+      if (auto glob = llvm::GlobPattern::create(entry.pattern))
+        components_.emplace_back(&entry, std::move(*glob));
+      else
+        llvm::consumeError(glob.takeError());
+    }
+    default_component_ = {{}, options_.export_macro, options_.include_header};
+  }
+
+  std::vector<finding> take_findings() {
+    return std::move(findings_);
+  }
+
+  const idt::statistics &statistics() const {
+    return statistics_;
+  }
+
+  // Report the declarations which are explicitly annotated for export but are
+  // not part of the public interface. This must be run after the translation
+  // unit has been traversed, as a private member may be referenced from inline
+  // code after its declaration.
+  void find_over_exports() {
+    for (const clang::NamedDecl *D : annotated_decls_) {
+      const char *reason = get_over_export_reason(D);
+      if (!reason)
+        continue;
+
+      const clang::Attr *A = get_explicit_export_attr(D);
+      exported_private_interface(
+          D, source_manager_.getExpansionLoc(A->getLocation()),
+          remove_export_macro(A), reason);
+    }
+  }
+
+  // Record the declarations which are explicitly annotated for export for the
+  // export report.
+  void find_exported_interfaces() {
+    for (const clang::NamedDecl *D : annotated_decls_) {
+      const clang::Attr *A = get_explicit_export_attr(D);
+      findings_.push_back({finding_kind::exported_interface, D,
+                           source_manager_.getExpansionLoc(A->getLocation()),
+                           {}, {}, estimate_exported_symbols(D)});
+    }
+  }
+
+  // Record the implicit instantiations of a class template declared in a
+  // header for the extern template report. A specialization which already has
+  // an explicit instantiation declaration or definition is not instantiated
+  // implicitly, and is not reported.
+  void record_instantiations(const clang::ClassTemplateDecl *CTD) {
+    if (is_in_system_header(CTD) || !is_in_header(CTD))
+      return;
+
+    clang::PrintingPolicy policy = context_.getPrintingPolicy();
+    policy.SuppressUnwrittenScope = true;
+
+    for (const clang::ClassTemplateSpecializationDecl *SD :
+         CTD->specializations()) {
+      if (SD->getSpecializationKind() != clang::TSK_ImplicitInstantiation)
+        continue;
+
+      // Only specializations which were instantiated incur the cost.
+      if (!SD->isCompleteDefinition())
+        continue;
+
+      if (!can_instantiate_explicitly(SD->getTemplateArgs()))
+        continue;
+
+      std::string spelling;
+      llvm::raw_string_ostream os(spelling);
+      SD->getNameForDiagnostic(os, policy, /*Qualified=*/true);
+
+      findings_.push_back({finding_kind::template_instantiation, SD,
+                           get_location(CTD), {}, std::move(spelling), 0});
+    }
+  }
+
+  // Determine if the library can provide an explicit instantiation for the
+  // arguments. This requires that the types involved are declared in headers,
+  // as opposed to within the source file of the client.
+  bool can_instantiate_explicitly(const clang::TemplateArgumentList &args) const {
+    for (const clang::TemplateArgument &arg : args.asArray()) {
+      switch (arg.getKind()) {
+      case clang::TemplateArgument::Integral:
+        continue;
+      case clang::TemplateArgument::Type:
+        if (const clang::TagDecl *TD = arg.getAsType()->getAsTagDecl())
+          if (!(is_in_header(TD) || is_in_system_header(TD)))
+            return false;
+        continue;
+      default:
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool TraverseDecl(clang::Decl *D) {
+    if (progress_)
+      progress_();
+    return RecursiveASTVisitor::TraverseDecl(D);
+  }
+
+  bool TraverseCXXRecordDecl(clang::CXXRecordDecl *RD) {
+    record_annotated_decl(RD);
+    export_record_if_needed(RD);
+
+    // Traverse the class by invoking the parent's version of this method. This
+    // call is required even if the record is exported because it may contain
+    // nested records.
+    return RecursiveASTVisitor::TraverseCXXRecordDecl(RD);
+  }
+
+  // RecursiveASTVisitor::TraverseCXXRecordDecl does not get called for fully
+  // specialized template declarations. Since we may want to export them,
+  // manually invoke TraverseCXXRecordDecl whenever an explicit specialization
+  // is found.
+  bool TraverseClassTemplateSpecializationDecl(
+      clang::ClassTemplateSpecializationDecl *SD) {
+    switch (SD->getSpecializationKind()) {
+    case clang::TSK_ExplicitSpecialization:
+      // This call visits class template specialization record and recursively
+      // visits all of it children, which may also require export.
+      return TraverseCXXRecordDecl(SD);
+
+    // TODO: consider annotating explicit template instantiation declarations
+    // and definitions in the future. They may require unique annotation macros
+    // due to differences between visibility and dllexport/dllimport attributes.
+    // The extern template report suggests explicit instantiations annotated
+    // with a separate macro, but does not annotate the existing ones.
+    case clang::TSK_ExplicitInstantiationDeclaration:
+      [[fallthrough]];
+    case clang::TSK_ExplicitInstantiationDefinition:
+      [[fallthrough]];
+    default:
+      return true;
+    }
+  }
+
+  // Implicit instantiations are not visited, so enumerate the specializations
+  // of each class template for the extern template report.
+  bool VisitClassTemplateDecl(clang::ClassTemplateDecl *CTD) {
+    if (options_.extern_templates && CTD == CTD->getCanonicalDecl())
+      record_instantiations(CTD);
+    return true;
+  }
+
+  // VisitFunctionDecl will visit all function declarations. This includes top-
+  // level functions as well as class member and static functions.
+  bool VisitFunctionDecl(clang::FunctionDecl *FD) {
+    record_annotated_decl(FD);
+
+    // Ignore private member function declarations. Any that require export will
+    // be identified by VisitCallExpr.
+    if (const auto *MD = llvm::dyn_cast<clang::CXXMethodDecl>(FD))
+      if (MD->getAccess() == clang::AccessSpecifier::AS_private)
+        return true;
+
+    export_function_if_needed(FD);
+    return true;
+  }
+
+  // Visit every function call in the compilation unit to determine if there are
+  // any inline calls to private member functions. In this uncommon case, the
+  // private method must be annotated for export.
+  bool VisitCallExpr(clang::CallExpr *CE) {
+    const clang::FunctionDecl *FD = CE->getDirectCallee();
+    if (!FD)
+      return true;
+
+    const clang::CXXMethodDecl *MD = llvm::dyn_cast<clang::CXXMethodDecl>(FD);
+    if (!MD)
+      return true;
+
+    // Only consider private methods here. Non-private methods will be
+    // considered for export by  VisitFunctionDecl.
+    if (MD->getAccess() == clang::AccessSpecifier::AS_private) {
+      record_private_reference(CE, MD);
+      export_function_if_needed(MD);
+    }
+
+    return true;
+  }
+
+  // Visit every unresolved member expression in the compilation unit to
+  // determine if there are overloaded private methods that might be called. In
+  // this uncommon case, the private method should be annotated.
+  bool VisitUnresolvedMemberExpr(clang::UnresolvedMemberExpr *E) {
+    // Iterate over potential declarations
+    for (const clang::NamedDecl *ND : E->decls())
+      if (const auto *MD = llvm::dyn_cast<clang::CXXMethodDecl>(ND))
+        if (MD->getAccess() == clang::AccessSpecifier::AS_private) {
+          record_private_reference(E, MD);
+          export_function_if_needed(MD);
+        }
+
+    return true;
+  }
+
+  // Visit every constructor call in the compilation unit to determine if there
+  // are any inline calls to private constructors. In this uncommon case, the
+  // private constructor must be annotated for export. Constructor calls are not
+  // visited by VisitCallExpr.
+  bool VisitCXXConstructExpr(clang::CXXConstructExpr *CE) {
+    const clang::CXXConstructorDecl *CD = CE->getConstructor();
+    if (!CD)
+      return true;
+
+    // Only consider private constructors here. Non-private constructors will be
+    // considered for export by  VisitFunctionDecl.
+    if (CD->getAccess() == clang::AccessSpecifier::AS_private) {
+      record_private_reference(CE, CD);
+      export_function_if_needed(CD);
+    }
+
+    return true;
+  }
+
+  // VisitVarDecl will visit all variable declarations as well as static fields
+  // in classes and structs. Non-static fields are not visited by this method.
+  bool VisitVarDecl(clang::VarDecl *VD) {
+    record_annotated_decl(VD);
+
+    // Ignore private static field declarations. Any that require export will be
+    // identified by VisitDeclRefExpr.
+    if (VD->getAccess() == clang::AccessSpecifier::AS_private)
+      return true;
+
+    export_variable_if_needed(VD);
+    return true;
+  }
+
+  // Visit every variable reference in the compilation unit to determine if
+  // there are any inline references to private, static member fields. In this
+  // uncommon case, the private field must be annotated for export.
+  bool VisitDeclRefExpr(clang::DeclRefExpr *DRE) {
+    // Only consider expresions referencing variable declarations. This includes
+    // static fields and local variables but not member variables, which are
+    // type FieldDecl.
+    auto *VD = llvm::dyn_cast<clang::VarDecl>(DRE->getDecl());
+    if (!VD)
+      return true;
+
+    // Only consider private fields here. Non-private fields will be considered
+    // for export by VisitVarDecl.
+    if (VD->getAccess() != clang::AccessSpecifier::AS_private)
+      return true;
+
+    record_private_reference(DRE, VD);
+    export_variable_if_needed(VD);
+    return true;
+  }
+};
+
+std::vector<finding> analyze(clang::ASTContext &context,
+                             const idt::options &options,
+                             const PPCallbacks::FileIncludes &file_includes,
+                             export_index *index, statistics *stats,
+                             llvm::function_ref<void()> progress) {
+  idt::visitor visitor{context, options, file_includes, index, progress};
+  // The translation unit is traversed on one thread. The AST is not read-only
+  // while it is analyzed: the source manager caches the file of the last
+  // location, line tables and record layouts are computed on first use, and
+  // the export decisions for a class and its members depend on each other, so
+  // the top-level declarations cannot be split between threads.
+  visitor.TraverseDecl(context.getTranslationUnitDecl());
+  if (options.over_exports)
+    visitor.find_over_exports();
+  if (records_exported_interfaces(options))
+    visitor.find_exported_interfaces();
+  if (stats) {
+    *stats += visitor.statistics();
+    ++stats->translation_units;
+  }
+  return visitor.take_findings();
+}
+
+const char *get_description(predicate check) {
+  switch (check) {
+  case predicate::already_exported:
+    return "already exported";
+  case predicate::system_header:
+    return "in a system header";
+  case predicate::not_header:
+    return "not in a header";
+  case predicate::dependent_context:
+    return "in a dependent context";
+  case predicate::visible_definition:
+    return "has a definition visible to clients";
+  case predicate::instantiation:
+    return "instantiated from a template";
+  case predicate::friend_declaration:
+    return "a friend declaration";
+  case predicate::deleted_or_defaulted:
+    return "deleted or defaulted";
+  case predicate::deduction_guide:
+    return "a deduction guide";
+  case predicate::pure_virtual:
+    return "pure virtual";
+  case predicate::builtin:
+    return "a known builtin";
+  case predicate::ignored:
+    return "ignored";
+  case predicate::local_variable:
+    return "a local variable";
+  case predicate::initialized:
+    return "initialized";
+  case predicate::not_extern:
+    return "neither extern nor a static member";
+  case predicate::class_template_member:
+    return "a member of a class template";
+  case predicate::templated:
+    return "a template";
+  case predicate::no_out_of_line_virtual_method:
+    return "without an out-of-line virtual method";
+  case predicate::no_component:
+    return "in no component";
+  case predicate::not_targeted:
+    return "not targeted";
+  case predicate::decided_elsewhere:
+    return "decided by another source";
+  }
+  llvm_unreachable("unexpected predicate");
+}
+
+statistics &statistics::operator+=(const statistics &other) {
+  translation_units += other.translation_units;
+  file_lookups += other.file_lookups;
+  file_hits += other.file_hits;
+  context_lookups += other.context_lookups;
+  context_hits += other.context_hits;
+  filtered_headers += other.filtered_headers;
+  for (std::size_t index = 0; index < kPredicates; ++index) {
+    evaluations[index] += other.evaluations[index];
+    rejections[index] += other.rejections[index];
+    predicate_times[index] += other.predicate_times[index];
+  }
+  return *this;
+}
+
+void report(clang::DiagnosticsEngine &diagnostics,
+            llvm::ArrayRef<finding> findings) {
+  for (const finding &result : findings) {
+    switch (result.kind) {
+    case finding_kind::missing_include: {
+      unsigned id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Remark, "missing include statement %0");
+      diagnostics.Report(result.location, id)
+          << result.argument << result.fixit;
+      break;
+    }
+    case finding_kind::unexported_public_interface: {
+      unsigned id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Remark, "unexported public interface %0");
+      diagnostics.Report(result.location, id) << result.decl << result.fixit;
+      break;
+    }
+    case finding_kind::exported_private_interface: {
+      unsigned id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Remark,
+          "exported private interface %0 (%1)");
+      diagnostics.Report(result.location, id)
+          << result.decl << result.argument << result.fixit;
+      break;
+    }
+    case finding_kind::explanation: {
+      unsigned id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Remark, "explain %0: %1");
+      diagnostics.Report(result.location, id) << result.decl << result.argument;
+      break;
+    }
+    case finding_kind::exported_interface:
+    case finding_kind::template_instantiation:
+    case finding_kind::untargeted_interface:
+      break;
+    }
+  }
+}
+
+void summary::add(clang::ASTContext &context,
+                  llvm::ArrayRef<finding> findings) {
+  const clang::SourceManager &source_manager = context.getSourceManager();
+
+  std::unique_ptr<clang::MangleContext> mangler;
+  if (options_.symbol_file != symbol_file_format::none || options_.snapshot)
+    mangler.reset(context.createMangleContext());
+
+  for (const finding &result : findings) {
+    if (merges_configurations(options_))
+      fixits_.add(source_manager, context.getLangOpts(), result.fixit);
+
+    if (result.kind == finding_kind::missing_include ||
+        result.kind == finding_kind::explanation)
+      continue;
+
+    if (result.kind == finding_kind::unexported_public_interface ||
+        result.kind == finding_kind::exported_interface) {
+      if (merges_configurations(options_)) {
+        llvm::SmallString<128> usr;
+        if (!clang::index::generateUSRForDecl(result.decl, usr)) {
+          configuration_export &declaration = exports_[usr.str().str()];
+          if (declaration.name.empty())
+            declaration.name = result.decl->getQualifiedNameAsString();
+          declaration.configurations.insert(configuration_);
+        }
+      }
+      if (options_.symbol_file != symbol_file_format::none)
+        mangle_exported_symbols(*mangler, result.decl, symbols_);
+      if (options_.snapshot)
+        snapshot_.add(*mangler, result.decl,
+                      result.kind == finding_kind::exported_interface);
+    }
+
+    if (result.kind == finding_kind::template_instantiation) {
+      auto &specialization = instantiations_[result.argument];
+      if (specialization.count++ == 0) {
+        specialization.tag =
+            llvm::cast<clang::CXXRecordDecl>(result.decl)->getKindName().str();
+        specialization.header =
+            source_manager.getFilename(result.location).str();
+      }
+      continue;
+    }
+
+    // Headers are visited by many translation units; identify the declaration
+    // by its location so that it is only counted once.
+    const clang::PresumedLoc location =
+        source_manager.getPresumedLoc(result.location);
+    if (location.isInvalid())
+      continue;
+
+    const auto *RD = llvm::dyn_cast<clang::CXXRecordDecl>(result.decl);
+    findings_.insert(
+        {static_cast<std::uint8_t>(result.kind), RD != nullptr,
+         findings_.intern(location.getFilename()),
+         source_manager.getDecomposedExpansionLoc(result.location).second,
+         location.getLine(), location.getColumn(),
+         findings_.intern(result.decl->getQualifiedNameAsString()),
+         findings_.intern(get_enclosing_namespace(result.decl)),
+         findings_.intern(get_enclosing_record(result.decl)), result.symbols,
+         RD ? estimate_member_exported_symbols(RD) : result.symbols});
+  }
+}
+
+void summary::print(llvm::raw_ostream &os) const {
+  if (options_.over_exports)
+    print_over_exports(os);
+  if (!options_.target_symbols.empty())
+    print_untargeted_interface(os);
+  if (options_.export_report)
+    print_export_report(os);
+  if (options_.extern_templates)
+    print_extern_templates(os);
+  if (options_.profile_headers)
+    header_profile_.print(os, options_.profile_headers_limit);
+  if (options_.stats)
+    print_statistics(os);
+  if (merges_configurations(options_)) {
+    print_configuration_differences(os);
+    if (!options_.apply_fixits)
+      fixits_.print(os);
+    if (fixits_.conflicts())
+      os << "warning: " << fixits_.conflicts()
+         << " conflicting changes were not merged\n";
+  }
+}
+
+void summary::merge(const summary &other) {
+  findings_.merge(other.findings_);
+
+  for (const auto &item : other.instantiations_) {
+    auto [specialization, inserted] = instantiations_.insert(item);
+    if (!inserted)
+      specialization->second.count += item.second.count;
+  }
+
+  header_profile_.merge(other.header_profile_);
+  for (const auto &symbol : other.symbols_)
+    symbols_[symbol.first] |= symbol.second;
+  snapshot_.merge(other.snapshot_);
+  statistics_ += other.statistics_;
+
+  for (const auto &item : other.exports_) {
+    configuration_export &declaration = exports_[item.first];
+    if (declaration.name.empty())
+      declaration.name = item.second.name;
+    declaration.configurations.insert(item.second.configurations.begin(),
+                                      item.second.configurations.end());
+  }
+  fixits_.merge(other.fixits_);
+}
+
+void summary::print_configuration_differences(llvm::raw_ostream &os) const {
+  const std::vector<std::string> &configurations = options_.configurations;
+
+  os << "configuration-dependent exports:\n";
+  for (const auto &item : exports_) {
+    const configuration_export &declaration = item.second;
+    if (declaration.configurations.size() == configurations.size())
+      continue;
+
+    os << "  " << declaration.name << ": not exported in";
+    for (unsigned index = 0; index < configurations.size(); ++index)
+      if (!declaration.configurations.count(index))
+        os << " '" << configurations[index] << '\'';
+    os << '\n';
+  }
+}
+
+void summary::print_statistics(llvm::raw_ostream &os) const {
+  os << "statistics:\n"
+     << "  translation units: " << statistics_.translation_units << '\n'
+     << "  file classifications: " << statistics_.file_lookups << " ("
+     << statistics_.file_hits << " cached)\n"
+     << "  enclosing class export status: " << statistics_.context_lookups
+     << " (" << statistics_.context_hits << " cached)\n"
+     << "  headers excluded by the header filter: "
+     << statistics_.filtered_headers << '\n'
+     << "  findings recorded: " << findings_.rows().size() << " ("
+     << (findings_.memory() + 1023) / 1024 << " KiB)\n";
+
+  os << "  predicates (evaluated, rejected, time):\n";
+  for (std::size_t index = 0; index < kPredicates; ++index) {
+    if (!statistics_.evaluations[index])
+      continue;
+    const std::chrono::duration<double, std::milli> time =
+        statistics_.predicate_times[index];
+    os << llvm::format("    %8u %8u %10.3f ms ", statistics_.evaluations[index],
+                       statistics_.rejections[index], time.count())
+       << get_description(static_cast<predicate>(index)) << '\n';
+  }
+}
+
+void summary::print_over_exports(llvm::raw_ostream &os) const {
+  unsigned count = 0;
+  unsigned symbols = 0;
+  for (const finding_table::row &declaration : findings_.rows()) {
+    if (declaration.kind !=
+        static_cast<std::uint8_t>(finding_kind::exported_private_interface))
+      continue;
+    ++count;
+    symbols += declaration.symbols;
+  }
+
+  os << count << " exported private interface" << (count == 1 ? "" : "s")
+     << "; removing the annotations would remove approximately " << symbols
+     << " symbol" << (symbols == 1 ? "" : "s")
+     << " from the dynamic symbol table\n";
+}
+
+void summary::print_untargeted_interface(llvm::raw_ostream &os) const {
+  // The members of a class which is not targeted are only counted with it.
+  const auto kUntargeted =
+      static_cast<std::uint8_t>(finding_kind::untargeted_interface);
+  std::set<unsigned> classes;
+  for (const finding_table::row &declaration : findings_.rows())
+    if (declaration.kind == kUntargeted && declaration.class_level)
+      classes.insert(declaration.record);
+
+  unsigned targeted = 0;
+  unsigned untargeted = 0;
+  unsigned symbols = 0;
+  for (const finding_table::row &declaration : findings_.rows()) {
+    if (declaration.kind ==
+        static_cast<std::uint8_t>(finding_kind::unexported_public_interface)) {
+      ++targeted;
+    } else if (declaration.kind == kUntargeted &&
+               (declaration.class_level ||
+                !contains(classes, declaration.record))) {
+      ++untargeted;
+      symbols += declaration.symbols;
+    }
+  }
+
+  os << "annotated " << targeted << " of " << targeted + untargeted
+     << " declarations requiring export; leaving the " << untargeted
+     << " untargeted declaration" << (untargeted == 1 ? "" : "s")
+     << " unexported omits approximately " << symbols << " symbol"
+     << (symbols == 1 ? "" : "s") << " from the dynamic symbol table\n";
+}
+
+void summary::print_export_report(llvm::raw_ostream &os) const {
+  using totals = std::map<std::string, unsigned>;
+
+  // Print the largest entries, ordered by the number of symbols.
+  auto print_largest = [&os, this](llvm::StringRef title, const totals &map) {
+    std::vector<std::pair<std::string, unsigned>> entries(map.begin(),
+                                                          map.end());
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto &lhs, const auto &rhs) {
+                       return lhs.second > rhs.second;
+                     });
+    if (entries.size() > options_.export_report_limit)
+      entries.resize(options_.export_report_limit);
+
+    os << title << ":\n";
+    for (const auto &entry : entries)
+      os << "  " << entry.second << ' ' << entry.first << '\n';
+  };
+
+  unsigned annotated = 0;
+  unsigned proposed = 0;
+  totals headers, scopes, records;
+  std::vector<const finding_table::row *> class_level;
+
+  // The rows are visited in order of their location, so that classes with the
+  // same number of symbols are listed in the same order by every run.
+  for (const finding_table::row *row : findings_.sorted()) {
+    const finding_table::row &declaration = *row;
+    switch (static_cast<finding_kind>(declaration.kind)) {
+    case finding_kind::exported_interface:
+      annotated += declaration.symbols;
+      break;
+    case finding_kind::unexported_public_interface:
+      proposed += declaration.symbols;
+      break;
+    default:
+      continue;
+    }
+
+    headers[findings_.str(declaration.file).str()] += declaration.symbols;
+    scopes[findings_.str(declaration.scope).str()] += declaration.symbols;
+    if (!findings_.str(declaration.record).empty())
+      records[findings_.str(declaration.record).str()] += declaration.symbols;
+    if (declaration.class_level)
+      class_level.push_back(&declaration);
+  }
+
+  const unsigned total = annotated + proposed;
+  os << "estimated exported symbols: " << total << " (" << annotated
+     << " annotated, " << proposed << " proposed)\n";
+
+  print_largest("exported symbols by header", headers);
+  print_largest("exported symbols by namespace", scopes);
+  print_largest("exported symbols by class", records);
+
+  // The classes for which exporting the members individually would save the
+  // most symbols.
+  std::stable_sort(class_level.begin(), class_level.end(),
+                   [](const finding_table::row *lhs,
+                      const finding_table::row *rhs) {
+                     return lhs->symbols > rhs->symbols;
+                   });
+  if (class_level.size() > options_.export_report_limit)
+    class_level.resize(options_.export_report_limit);
+
+  os << "most costly class-level exports:\n";
+  for (const finding_table::row *declaration : class_level)
+    os << "  " << declaration->symbols << ' '
+       << findings_.str(declaration->record) << " ("
+       << declaration->member_symbols << " with member-level export)\n";
+
+  const uint64_t budget = options_.export_budget;
+  if (total > budget)
+    os << "warning: the estimated number of exported symbols (" << total
+       << ") exceeds the budget of " << budget << '\n';
+  else if (uint64_t{total} * 10 >= budget * 9)
+    os << "warning: the estimated number of exported symbols (" << total
+       << ") is within 10% of the budget of " << budget << '\n';
+}
+
+void summary::print_extern_templates(llvm::raw_ostream &os) const {
+  std::vector<std::pair<std::string, instantiation>> candidates;
+  for (const auto &item : instantiations_)
+    if (item.second.count >= options_.extern_template_threshold)
+      candidates.push_back(item);
+
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const auto &lhs, const auto &rhs) {
+                     return lhs.second.count > rhs.second.count;
+                   });
+  if (candidates.size() > options_.extern_template_limit)
+    candidates.resize(options_.extern_template_limit);
+
+  const std::string macro = options_.extern_template_macro.empty()
+                                ? std::string{}
+                                : options_.extern_template_macro + " ";
+
+  // The explicit instantiation declaration prevents the instantiation in the
+  // clients which include the header, and the explicit instantiation
+  // definition provides the single instantiation from the library.
+  os << "extern template candidates:\n";
+  for (const auto &candidate : candidates) {
+    const instantiation &specialization = candidate.second;
+    os << "  " << candidate.first << ": instantiated in "
+       << specialization.count << " translation units\n"
+       << "    header " << specialization.header << ": extern template "
+       << specialization.tag << ' ' << macro << candidate.first << ";\n"
+       << "    source: template " << specialization.tag << ' ' << macro
+       << candidate.first << ";\n";
+  }
+}
+
+void summary::write_symbol_file(llvm::raw_ostream &os) const {
+  switch (options_.symbol_file) {
+  case symbol_file_format::none:
+    break;
+  case symbol_file_format::version_script:
+    // The symbols which are not listed are made local, which hides them as if
+    // built with -fvisibility=hidden.
+    os << "{\n  global:\n";
+    for (const auto &symbol : symbols_)
+      os << "    " << symbol.first << ";\n";
+    os << "  local:\n    *;\n};\n";
+    break;
+  case symbol_file_format::exported_symbols_list:
+    // Mach-O prefixes the names of all symbols with an underscore.
+    for (const auto &symbol : symbols_)
+      os << '_' << symbol.first << '\n';
+    break;
+  case symbol_file_format::module_definition:
+    os << "EXPORTS\n";
+    for (const auto &symbol : symbols_)
+      os << "  " << symbol.first << (symbol.second ? " DATA" : "") << '\n';
+    break;
+  }
+}
+
+void summary::write_findings(llvm::raw_ostream &os) const {
+  for (const finding_table::row *row : findings_.sorted()) {
+    const char *description = nullptr;
+    switch (static_cast<finding_kind>(row->kind)) {
+    case finding_kind::unexported_public_interface:
+      description = "unexported public interface";
+      break;
+    case finding_kind::exported_private_interface:
+      description = "exported private interface";
+      break;
+    case finding_kind::exported_interface:
+      description = "exported interface";
+      break;
+    case finding_kind::untargeted_interface:
+      description = "untargeted interface";
+      break;
+    case finding_kind::missing_include:
+    case finding_kind::template_instantiation:
+    case finding_kind::explanation:
+      continue;
+    }
+
+    os << findings_.str(row->file) << ':' << row->line << ':' << row->column
+       << ": " << description << " '" << findings_.str(row->name) << "' ("
+       << row->symbols << " symbol" << (row->symbols == 1 ? "" : "s")
+       << ")\n";
+  }
+}
+
+consumer::consumer(const idt::options &options,
+                   const PPCallbacks::FileIncludes &file_includes,
+                   idt::summary *summary, export_index *index,
+                   std::function<void()> progress)
+    : options_(options), file_includes_(file_includes), summary_(summary),
+      index_(index), progress_(std::move(progress)), fixit_options_(options) {}
+
+void consumer::HandleTranslationUnit(clang::ASTContext &context) {
+  if (options_.apply_fixits) {
+    clang::DiagnosticsEngine &diagnostics_engine = context.getDiagnostics();
+    rewriter_ =
+        std::make_unique<clang::FixItRewriter>(diagnostics_engine,
+                                               context.getSourceManager(),
+                                               context.getLangOpts(),
+                                               &fixit_options_);
+    diagnostics_engine.setClient(rewriter_.get(), /*ShouldOwnClient=*/false);
+  }
+
+  const std::vector<finding> findings =
+      analyze(context, options_, file_includes_, index_,
+              summary_ ? &summary_->stats() : nullptr, progress_);
+  report(context.getDiagnostics(), findings);
+  if (summary_)
+    summary_->add(context, findings);
+
+  if (options_.apply_fixits)
+    rewriter_->WriteFixedFiles();
+}
+
+void action::ExecuteAction() {
+  if (requires_includes(options_))
+    installPPCallbacks();
+  if (options_.profile_headers && summary_)
+    installHeaderProfiler();
+  clang::ASTFrontendAction::ExecuteAction();
+}
+
+std::unique_ptr<clang::ASTConsumer>
+action::CreateASTConsumer(clang::CompilerInstance &CI, llvm::StringRef) {
+  return std::make_unique<idt::consumer>(options_, file_includes_, summary_,
+                                         index_, progress_);
+}
+
+void action::installPPCallbacks() {
+  clang::CompilerInstance &compiler_instance = getCompilerInstance();
+  clang::Preprocessor &preprocessor = compiler_instance.getPreprocessor();
+  clang::SourceManager &source_manager = compiler_instance.getSourceManager();
+  preprocessor.addPPCallbacks(
+      std::make_unique<PPCallbacks>(source_manager, file_includes_));
+}
+
+void action::installHeaderProfiler() {
+  clang::CompilerInstance &compiler_instance = getCompilerInstance();
+  clang::Preprocessor &preprocessor = compiler_instance.getPreprocessor();
+  clang::SourceManager &source_manager = compiler_instance.getSourceManager();
+  preprocessor.addPPCallbacks(
+      std::make_unique<header_profiler>(source_manager, summary_->headers()));
+}
+}
@@ -0,0 +1,32 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_client_usage_hh
+#define idt_client_usage_hh
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+
+#include <set>
+#include <string>
+
+namespace idt {
+// Records the qualified names of the declarations outside of the main file and
+// the system headers which a client translation unit references, i.e. the
+// library interfaces it uses. The inline functions which are referenced are
+// followed, as their definitions are emitted into the client and require the
+// declarations which they reference in turn. Constructing an object requires
+// its destructor, and its vtable if it is polymorphic, so the class is
+// recorded with its constructor.
+class client_usage_consumer : public clang::ASTConsumer {
+  std::set<std::string> &references_;
+
+public:
+  explicit client_usage_consumer(std::set<std::string> &references)
+      : references_(references) {}
+
+  void HandleTranslationUnit(clang::ASTContext &context) override;
+};
+}
+
+#endif
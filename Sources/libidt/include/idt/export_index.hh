@@ -0,0 +1,81 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_export_index_hh
+#define idt_export_index_hh
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+
+namespace idt {
+// The declarations which have been decided to be exported, keyed by their USR.
+// The index is shared by the translation units of a run, and may be persisted
+// so that a later run does not suggest the same annotations again. It is
+// sharded by the hash of the USR so that concurrent scans rarely contend.
+//
+// Each decision records whether its suggested change was applied. A decision
+// which was only reported still suppresses the findings of a later run which
+// only reports, but a run which applies the changes decides it again, so that
+// the declaration is annotated.
+//
+// An index may be layered over another, whose decisions it treats as its own
+// without adding to them, to hold the decisions of a single translation unit
+// until they are merged into the other.
+class export_index {
+  enum class decision : unsigned char { reported, applied };
+
+  struct shard {
+    mutable std::mutex mutex;
+    llvm::StringMap<decision> usrs;
+  };
+
+  static constexpr std::size_t kShards = 16;
+  std::array<shard, kShards> shards_;
+
+  // Whether the suggested changes of the run are applied.
+  bool applies_;
+
+  // The index which this index is layered over, if any.
+  const export_index *base_ = nullptr;
+
+  shard &get_shard(llvm::StringRef usr);
+  const shard &get_shard(llvm::StringRef usr) const;
+
+  void insert(llvm::StringRef usr, decision state);
+
+public:
+  explicit export_index(bool applies = false) : applies_(applies) {}
+
+  // Create an empty index layered over `base`, which must outlive it.
+  explicit export_index(const export_index *base)
+      : applies_(base->applies_), base_(base) {}
+
+  // Record the decision to export the declaration. Returns false if it had
+  // already been decided.
+  bool insert(llvm::StringRef usr);
+
+  bool contains(llvm::StringRef usr) const;
+
+  std::size_t size() const;
+
+  // Add the declarations recorded by another index, excluding those of the
+  // index which it is layered over.
+  void merge(const export_index &other);
+
+  // Add the declarations recorded in `path`, which need not exist. The
+  // decisions which were only reported are ignored if the run applies the
+  // suggested changes.
+  llvm::Error load(llvm::StringRef path);
+
+  // Write the declarations to `path`, one per line in the order of their USR,
+  // as `applied <usr>` or `reported <usr>`.
+  llvm::Error save(llvm::StringRef path) const;
+};
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_file_cache_hh
+#define idt_file_cache_hh
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <memory>
+#include <mutex>
+
+namespace idt {
+// The contents of the files read by the analyses which run concurrently, e.g.
+// of the same sources in different configurations, keyed by their absolute
+// path. Each file is read from the disk once.
+class file_cache {
+  struct entry {
+    llvm::vfs::Status status;
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+  };
+
+  std::mutex mutex_;
+  llvm::StringMap<entry> entries_;
+
+  const entry *find(llvm::StringRef path);
+
+  // Read the file at the absolute, normalized `path` from `fs`, unless it is
+  // already cached. The entries are only removed between analyses, so they
+  // remain valid while in use.
+  llvm::ErrorOr<const entry *> get(llvm::vfs::FileSystem &fs,
+                                   llvm::StringRef path);
+
+  friend class cached_file_system;
+
+public:
+  // Read the file at the absolute, normalized `path` into the cache ahead of
+  // its use. Returns its contents, or null if it cannot be read.
+  const llvm::MemoryBuffer *prefetch(llvm::vfs::FileSystem &fs,
+                                     llvm::StringRef path);
+
+  // Remove the file at the absolute, normalized `path`, e.g. as it changed,
+  // so that it is read again. The cache must not be in use by an analysis.
+  void invalidate(llvm::StringRef path);
+};
+
+// A file system which reads the files through a shared cache. Each analysis
+// has its own instance, as the working directory is set per compile command.
+class cached_file_system : public llvm::vfs::ProxyFileSystem {
+  file_cache &cache_;
+
+public:
+  cached_file_system(file_cache &cache,
+                     llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs)
+      : llvm::vfs::ProxyFileSystem(std::move(fs)), cache_(cache) {}
+
+  llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine &path) override;
+
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+  openFileForRead(const llvm::Twine &path) override;
+};
+}
+
+#endif
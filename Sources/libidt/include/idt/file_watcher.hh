@@ -0,0 +1,50 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_file_watcher_hh
+#define idt_file_watcher_hh
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Chrono.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace idt {
+// Detects the changes to a set of files by polling their status, which is
+// portable and, for the few thousand files reached by the sources of a
+// project, cheap enough to repeat several times a second.
+class file_watcher {
+  struct state {
+    bool exists;
+    llvm::sys::TimePoint<> modified;
+    std::uint64_t size;
+
+    bool operator==(const state &other) const {
+      return exists == other.exists && modified == other.modified &&
+             size == other.size;
+    }
+  };
+
+  // The files, keyed by their absolute path, with their status when they
+  // were last polled.
+  std::map<std::string, state> files_;
+
+  static state get_state(llvm::StringRef path);
+
+public:
+  // Watch the file, unless it is already watched.
+  void watch(llvm::StringRef path);
+
+  std::size_t size() const { return files_.size(); }
+
+  // Determine the files which were modified, created or removed since they
+  // were last polled.
+  std::vector<std::string> poll();
+};
+}
+
+#endif
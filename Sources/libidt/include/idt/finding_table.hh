@@ -0,0 +1,95 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_finding_table_hh
+#define idt_finding_table_hh
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace idt {
+// The findings of a run, accumulated across its translation units for the
+// reports printed once it completes. Each finding is a fixed size row, and
+// the file names and declaration names which the rows refer to are interned
+// once in an arena, so that the table stays small for millions of findings.
+// Headers are visited by many translation units, so a finding is only added
+// once for each kind, location and declaration.
+class finding_table {
+public:
+  struct row {
+    // The kind of the finding, a `finding_kind`.
+    std::uint8_t kind;
+
+    // Whether this is a class exported at the class level.
+    bool class_level;
+
+    // The file containing the finding, and its location in the file.
+    unsigned file;
+    unsigned offset;
+    unsigned line;
+    unsigned column;
+
+    // The qualified name of the declaration, and of the namespace and the
+    // class which it belongs to.
+    unsigned name;
+    unsigned scope;
+    unsigned record;
+
+    // The estimated number of symbols exported by the declaration, and, for a
+    // class exported at the class level, if its members were exported
+    // individually instead.
+    unsigned symbols;
+    unsigned member_symbols;
+  };
+
+private:
+  // The interned strings, by value, allocated in the arena of the map, and by
+  // index.
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator> ids_;
+  std::vector<llvm::StringRef> strings_;
+
+  std::vector<row> rows_;
+
+  // The rows, keyed by their kind, file, offset and name.
+  using key = std::tuple<unsigned, unsigned, unsigned, unsigned>;
+  llvm::DenseMap<key, unsigned> index_;
+
+public:
+  finding_table() = default;
+  finding_table(const finding_table &) = delete;
+  finding_table &operator=(const finding_table &) = delete;
+
+  // Intern a string, returning its index in the table.
+  unsigned intern(llvm::StringRef string);
+
+  llvm::StringRef str(unsigned id) const { return strings_[id]; }
+
+  // Add a row whose strings are interned in this table, unless a row of the
+  // same kind for the same location and declaration exists. Returns whether
+  // the row was added.
+  bool insert(const row &entry);
+
+  // Add the rows of another table, e.g. of another configuration.
+  void merge(const finding_table &other);
+
+  llvm::ArrayRef<row> rows() const { return rows_; }
+
+  // The rows ordered by file name, offset, kind and declaration name, which
+  // does not depend on the order in which the translation units were
+  // analyzed.
+  std::vector<const row *> sorted() const;
+
+  // The memory used by the table, in bytes.
+  std::size_t memory() const;
+};
+}
+
+#endif
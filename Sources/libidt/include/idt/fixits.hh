@@ -0,0 +1,65 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_fixits_hh
+#define idt_fixits_hh
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+namespace idt {
+// The fix-it hints of several analyses of the same files, e.g. in different
+// configurations, keyed by their position in the file so that each change is
+// made once.
+class fixit_set {
+  struct edit {
+    // The number of characters replaced.
+    unsigned length;
+
+    // The start and end of the replaced range, for printing.
+    unsigned line;
+    unsigned column;
+    unsigned end_line;
+    unsigned end_column;
+
+    std::string text;
+  };
+
+  // The edits of each file, keyed by offset.
+  std::map<std::string, std::map<unsigned, edit>> edits_;
+
+  // The number of edits which differ from an edit at the same offset, and
+  // which were dropped.
+  unsigned conflicts_ = 0;
+
+  void insert(llvm::StringRef file, unsigned offset, const edit &change);
+
+public:
+  // Add the hint, unless it is within a macro expansion and cannot be
+  // mapped to the file.
+  void add(const clang::SourceManager &source_manager,
+           const clang::LangOptions &language_options,
+           const clang::FixItHint &hint);
+
+  void merge(const fixit_set &other);
+
+  std::size_t size() const;
+  unsigned conflicts() const { return conflicts_; }
+
+  // Print the edits in the format of `-fdiagnostics-parseable-fixits`.
+  void print(llvm::raw_ostream &os) const;
+
+  // Apply the edits to the files in place.
+  llvm::Error apply() const;
+};
+}
+
+#endif
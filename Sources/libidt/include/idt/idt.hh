@@ -0,0 +1,464 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_idt_hh
+#define idt_idt_hh
+
+#include "idt/export_index.hh"
+#include "idt/finding_table.hh"
+#include "idt/fixits.hh"
+#include "idt/profile.hh"
+#include "idt/snapshot.hh"
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Rewrite/Frontend/FixItRewriter.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace idt {
+// The formats of the list of the symbols to export.
+enum class symbol_file_format {
+  none,
+  // An ELF version script, for `--version-script`.
+  version_script,
+  // A Mach-O exported symbols list, for `-exported_symbols_list`.
+  exported_symbols_list,
+  // A Windows module definition file, for `/DEF`.
+  module_definition,
+};
+
+// A part of the project, e.g. one of its libraries, whose headers are
+// annotated with its own export macro.
+struct component {
+  // A path prefix, or a glob if it contains any of `*?[{`, matching the
+  // headers of the component.
+  std::string pattern;
+
+  // The macro to decorate the interfaces of the component with.
+  std::string export_macro;
+
+  // The header required for the export macro, if any.
+  std::string include_header;
+};
+
+// The configuration of a scan. This is populated from the command line by the
+// idt tool and from the plugin arguments by the clang plugin.
+struct options {
+  // The macro to decorate interfaces with.
+  std::string export_macro;
+
+  // The header required for the export macro, if any.
+  std::string include_header;
+
+  // The components of the project. A header is annotated with the export
+  // macro of the first component which matches it, or with the export macro
+  // above if none do.
+  std::vector<component> components;
+
+  // Apply the suggested changes rather than only reporting them.
+  bool apply_fixits = false;
+
+  // Apply the suggested changes to the original files.
+  bool inplace = false;
+
+  // The extensions of the files which are considered headers.
+  std::vector<std::string> header_extensions{".h", ".hh", ".hpp", ".hxx"};
+
+  // A pattern which the headers to annotate must match, if any.
+  std::string header_filter;
+
+  // Functions and variables which should never be annotated.
+  std::set<std::string> ignored_symbols;
+
+  // The qualified names of the declarations to annotate, e.g. the symbols
+  // which a link reported as undefined. A class is annotated if any of its
+  // members are named. Every declaration is annotated if this is empty.
+  std::set<std::string> target_symbols;
+
+  // Report exported declarations which are not part of the public interface.
+  bool over_exports = false;
+
+  // Patterns matching the headers which are not part of the public interface.
+  std::vector<std::string> private_headers;
+
+  // Namespaces which contain implementation details by convention.
+  std::set<std::string> internal_namespaces{"detail", "details", "impl",
+                                            "internal"};
+
+  // Report the estimated number of exported symbols once the run completes.
+  bool export_report = false;
+
+  // The maximum number of exported symbols. This defaults to the limit on the
+  // number of symbols exported from a Windows DLL.
+  unsigned export_budget = 65535;
+
+  // The number of entries listed in each section of the export report.
+  unsigned export_report_limit = 10;
+
+  // Report the class template specializations which are implicitly
+  // instantiated by the most translation units once the run completes.
+  bool extern_templates = false;
+
+  // The macro to decorate explicit template instantiations with.
+  std::string extern_template_macro;
+
+  // The minimum number of translation units which must instantiate a
+  // specialization for it to be reported.
+  unsigned extern_template_threshold = 2;
+
+  // The number of specializations reported.
+  unsigned extern_template_limit = 10;
+
+  // Report the time spent processing each header once the run completes.
+  bool profile_headers = false;
+
+  // The number of headers reported.
+  unsigned profile_headers_limit = 20;
+
+  // The format of the list of the symbols to export, as an alternative to
+  // annotating the declarations, if any.
+  symbol_file_format symbol_file = symbol_file_format::none;
+
+  // Record a snapshot of the public interface.
+  bool snapshot = false;
+
+  // Record the findings of the run, ordered by their location.
+  bool findings = false;
+
+  // Report the statistics of the analysis once the run completes.
+  bool stats = false;
+
+  // The extra compiler arguments of each configuration in which the sources
+  // are analyzed, e.g. `-D_WIN32`. When there are several, the exported
+  // declarations of the configurations are compared and their suggested
+  // changes are merged.
+  std::vector<std::string> configurations;
+
+  // The qualified name of the declarations whose decisions are explained, if
+  // any.
+  std::string explain;
+};
+
+// The predicates which reject a declaration as a candidate for export.
+enum class predicate : unsigned {
+  already_exported,
+  system_header,
+  not_header,
+  dependent_context,
+  visible_definition,
+  instantiation,
+  friend_declaration,
+  deleted_or_defaulted,
+  deduction_guide,
+  pure_virtual,
+  builtin,
+  ignored,
+  local_variable,
+  initialized,
+  not_extern,
+  class_template_member,
+  templated,
+  no_out_of_line_virtual_method,
+  no_component,
+  not_targeted,
+  decided_elsewhere,
+};
+
+constexpr std::size_t kPredicates =
+    static_cast<std::size_t>(predicate::decided_elsewhere) + 1;
+
+// A description of the condition on which the predicate rejects a declaration.
+const char *get_description(predicate check);
+
+// Counters describing the work done by the analysis.
+struct statistics {
+  unsigned translation_units = 0;
+
+  // The classifications of the file containing a declaration, and those which
+  // were cached.
+  unsigned file_lookups = 0;
+  unsigned file_hits = 0;
+
+  // The lookups of the export status of the class enclosing a declaration,
+  // and those which were cached.
+  unsigned context_lookups = 0;
+  unsigned context_hits = 0;
+
+  // The headers which were not annotated as they did not match the header
+  // filter.
+  unsigned filtered_headers = 0;
+
+  // The evaluations of each predicate, those which rejected the declaration,
+  // and the time spent evaluating it.
+  std::array<unsigned, kPredicates> evaluations{};
+  std::array<unsigned, kPredicates> rejections{};
+  std::array<std::chrono::nanoseconds, kPredicates> predicate_times{};
+
+  statistics &operator+=(const statistics &other);
+};
+
+// Determine if a component pattern is a glob rather than a path prefix.
+bool is_glob(llvm::StringRef pattern);
+
+// Determine if the includes must be tracked to add the header required for an
+// export macro.
+bool requires_includes(const options &options);
+
+struct PPCallbacks : clang::PPCallbacks {
+  // Describes the source location of an #include statement and the name of the
+  // file being included.
+  using IncludeLocation = std::tuple<std::string, clang::SourceLocation>;
+
+  // Maps the name of a source file to list of include statements its contains
+  // in the order they are discovered int he file.
+  using FileIncludes =
+      std::unordered_map<std::string, std::vector<IncludeLocation>>;
+
+  PPCallbacks(const clang::SourceManager &source_manager,
+              FileIncludes &file_includes)
+      : source_manager_(source_manager), file_includes_(file_includes) {}
+
+  void
+  InclusionDirective(clang::SourceLocation HashLoc,
+                     const clang::Token &IncludeTok, clang::StringRef FileName,
+                     bool IsAngled, clang::CharSourceRange FilenameRange,
+                     clang::OptionalFileEntryRef File,
+                     clang::StringRef SearchPath, clang::StringRef RelativePath,
+                     const clang::Module *SuggestedModule, bool ModuleImported,
+                     clang::SrcMgr::CharacteristicKind FileType) override;
+
+private:
+  const clang::SourceManager &source_manager_;
+  FileIncludes &file_includes_;
+};
+
+enum class finding_kind {
+  // A declaration which is part of the public interface but is not exported.
+  unexported_public_interface,
+  // A declaration which is exported but is not part of the public interface.
+  exported_private_interface,
+  // A file which requires the header providing the export macro.
+  missing_include,
+  // A declaration which is already exported. These are only produced for the
+  // export report and are not reported as remarks.
+  exported_interface,
+  // An implicit instantiation of a class template declared in a header. These
+  // are only produced for the extern template report and are not reported as
+  // remarks.
+  template_instantiation,
+  // The evaluation of a predicate for the declaration named by `--explain`, or
+  // its verdict.
+  explanation,
+  // A declaration which requires export but is not one of the targeted
+  // symbols. These are only produced to report the size of the interface
+  // which is not annotated, and are not reported as remarks.
+  untargeted_interface,
+};
+
+// A single result of the analysis of a translation unit. The declaration and
+// the locations refer into the ASTContext which was analyzed.
+struct finding {
+  finding_kind kind;
+
+  // The declaration the finding refers to, null for a missing include.
+  const clang::NamedDecl *decl;
+
+  // The location at which the finding is reported.
+  clang::SourceLocation location;
+
+  // The suggested change.
+  clang::FixItHint fixit;
+
+  // The header to include for a missing include, the reason that an exported
+  // declaration is not part of the public interface, or the spelling of a
+  // template instantiation.
+  std::string argument;
+
+  // The estimated number of symbols exported due to the declaration.
+  unsigned symbols = 0;
+};
+
+// Analyze the translation unit in `context`, returning the findings in the
+// order in which they were discovered. `file_includes` are the include
+// directives recorded by `PPCallbacks` while the translation unit was parsed,
+// and are only required if `options.include_header` is set. If `index` is
+// provided, the declarations which it records are treated as exported, and
+// the declarations which are found to require export are added to it. If
+// `stats` is provided, the statistics of the analysis are added to it. If
+// `progress` is provided, it is called as each declaration is visited, e.g. to
+// abandon an analysis which runs past its deadline.
+//
+// The analysis does not depend on any global state, so several configurations
+// may be analyzed in the same process, or over the same ASTContext.
+std::vector<finding>
+analyze(clang::ASTContext &context, const idt::options &options,
+        const PPCallbacks::FileIncludes &file_includes = {},
+        export_index *index = nullptr, statistics *stats = nullptr,
+        llvm::function_ref<void()> progress = nullptr);
+
+// Report the findings as remarks through `diagnostics`, with the suggested
+// changes attached as fix-it hints.
+void report(clang::DiagnosticsEngine &diagnostics,
+            llvm::ArrayRef<finding> findings);
+
+// Accumulates the findings across the translation units of a run for the
+// reports which are printed once the run completes.
+class summary {
+  // A class template specialization which is implicitly instantiated.
+  struct instantiation {
+    // The class key of the specialization, e.g. `class` or `struct`.
+    std::string tag;
+
+    // The header declaring the template.
+    std::string header;
+
+    // The number of translation units which instantiate it.
+    unsigned count;
+  };
+
+  const idt::options &options_;
+
+  // The exported declarations, and those which should be exported or are
+  // exported but should not be.
+  finding_table findings_;
+
+  // The implicit instantiations, keyed by their spelling.
+  std::map<std::string, instantiation> instantiations_;
+
+  // The time spent processing each header.
+  header_profile header_profile_;
+
+  // The mangled names of the symbols to export, mapped to whether they name
+  // data rather than code.
+  std::map<std::string, bool> symbols_;
+
+  // The public interface declarations.
+  interface_snapshot snapshot_;
+
+  idt::statistics statistics_;
+
+  // The configuration which the summary is for, and the declarations which
+  // are exported, or which would be exported by the suggested annotations,
+  // keyed by their USR, with the configurations in which they are.
+  struct configuration_export {
+    std::string name;
+    std::set<unsigned> configurations;
+  };
+  unsigned configuration_;
+  std::map<std::string, configuration_export> exports_;
+
+  // The suggested changes, when merging those of several configurations.
+  fixit_set fixits_;
+
+  void print_over_exports(llvm::raw_ostream &os) const;
+  void print_untargeted_interface(llvm::raw_ostream &os) const;
+  void print_export_report(llvm::raw_ostream &os) const;
+  void print_extern_templates(llvm::raw_ostream &os) const;
+  void print_statistics(llvm::raw_ostream &os) const;
+  void print_configuration_differences(llvm::raw_ostream &os) const;
+
+public:
+  explicit summary(const idt::options &options, unsigned configuration = 0)
+      : options_(options), configuration_(configuration) {}
+
+  header_profile &headers() { return header_profile_; }
+  const interface_snapshot &snapshot() const { return snapshot_; }
+  idt::statistics &stats() { return statistics_; }
+  const fixit_set &fixits() const { return fixits_; }
+
+  void add(clang::ASTContext &context, llvm::ArrayRef<finding> findings);
+
+  // Add the results of another summary, e.g. of another configuration.
+  void merge(const summary &other);
+  void print(llvm::raw_ostream &os) const;
+
+  // Write the symbols which are exported, or which would be exported by the
+  // suggested annotations, in `options.symbol_file`.
+  void write_symbol_file(llvm::raw_ostream &os) const;
+
+  // Write the exported declarations, and those which should be exported or
+  // are exported but should not be, ordered by their location.
+  void write_findings(llvm::raw_ostream &os) const;
+};
+
+// Analyzes each translation unit and reports the findings, applying the fix-it
+// hints if requested.
+class consumer : public clang::ASTConsumer {
+  struct fixit_options : clang::FixItOptions {
+    fixit_options(const idt::options &options) {
+      InPlace = options.inplace;
+      Silent = options.apply_fixits;
+    }
+
+    std::string RewriteFilename(const std::string &filename, int &fd) override {
+      llvm_unreachable("unexpected call to RewriteFilename");
+    }
+  };
+
+  const idt::options &options_;
+  const PPCallbacks::FileIncludes &file_includes_;
+  idt::summary *summary_;
+  export_index *index_;
+  std::function<void()> progress_;
+
+  fixit_options fixit_options_;
+  std::unique_ptr<clang::FixItRewriter> rewriter_;
+
+public:
+  consumer(const idt::options &options,
+           const PPCallbacks::FileIncludes &file_includes,
+           idt::summary *summary = nullptr, export_index *index = nullptr,
+           std::function<void()> progress = nullptr);
+
+  void HandleTranslationUnit(clang::ASTContext &context) override;
+};
+
+struct action : clang::ASTFrontendAction {
+  explicit action(const idt::options &options, idt::summary *summary = nullptr,
+                  export_index *index = nullptr)
+      : options_(options), summary_(summary), index_(index) {}
+
+  void ExecuteAction() override;
+
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI, llvm::StringRef) override;
+
+protected:
+  // Called by the analysis as each declaration is visited, if set before the
+  // consumer is created.
+  std::function<void()> progress_;
+
+private:
+  // Install a callback that will be invoked on every preprocessor include
+  // statement. This is done so we can determine if a user-specified custom
+  // include statment needs to be added if any annotations are added.
+  void installPPCallbacks();
+
+  // Install a callback that will time each header as it is processed.
+  void installHeaderProfiler();
+
+  const idt::options &options_;
+  idt::summary *summary_;
+  export_index *index_;
+  PPCallbacks::FileIncludes file_includes_;
+};
+}
+
+#endif
@@ -0,0 +1,62 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_incremental_hh
+#define idt_incremental_hh
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace idt {
+// The files read by the analysis of each source and the digests of their
+// contents, so that a later run can skip the sources whose files, and compile
+// command, are unchanged. The record is written as text, one source followed
+// by its files, in sorted order:
+//
+//   source <command digest> <path>
+//   file <digest> <path>
+class incremental_record {
+  struct source {
+    std::uint64_t command;
+    std::map<std::string, std::uint64_t> files;
+  };
+
+  // The sources, keyed by their absolute path.
+  std::map<std::string, source> sources_;
+
+  // The digests of the files which have been read by `is_current`, or none if
+  // the file cannot be read.
+  llvm::StringMap<std::optional<std::uint64_t>> digests_;
+
+public:
+  // Determine if the source was recorded with the same compile command and if
+  // none of its files have changed since.
+  bool is_current(llvm::StringRef path, std::uint64_t command);
+
+  // Record the files read by the analysis of a source, replacing those
+  // recorded by an earlier run.
+  void update(llvm::StringRef path, std::uint64_t command,
+              std::map<std::string, std::uint64_t> files);
+
+  // Forget a source, e.g. one which could not be analyzed.
+  void remove(llvm::StringRef path) { sources_.erase(path.str()); }
+
+  std::size_t size() const { return sources_.size(); }
+
+  // Add the sources recorded in `path`, which need not exist.
+  llvm::Error load(llvm::StringRef path);
+
+  llvm::Error save(llvm::StringRef path) const;
+};
+
+// The digest of the contents of a file.
+std::uint64_t get_digest(llvm::StringRef contents);
+}
+
+#endif
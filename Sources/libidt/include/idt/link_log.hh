@@ -0,0 +1,52 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_link_log_hh
+#define idt_link_log_hh
+
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace idt {
+// Extract the qualified names of the symbols which a link reported as
+// undefined from its log. The logs of link.exe, lld and the GNU and Apple
+// linkers are recognized, and mangled names are demangled. The virtual table
+// and type information of a class are reported as the class itself.
+std::set<std::string> parse_link_log(llvm::StringRef log);
+
+// Determine the unqualified identifiers of `symbols`, which must appear in the
+// source of the headers declaring them, e.g. `bar` for `ns::foo::bar`.
+std::vector<std::string>
+get_symbol_identifiers(const std::set<std::string> &symbols);
+
+// Records the user files entered by the preprocessor which mention any of the
+// identifiers, i.e. the files which may declare the symbols. The results are
+// cached by file name, as headers are reached by many translation units.
+class symbol_reference_scanner : public clang::PPCallbacks {
+  const clang::SourceManager &source_manager_;
+  const std::vector<std::string> &identifiers_;
+  llvm::StringMap<bool> &cache_;
+  std::set<std::string> &files_;
+
+public:
+  symbol_reference_scanner(const clang::SourceManager &source_manager,
+                           const std::vector<std::string> &identifiers,
+                           llvm::StringMap<bool> &cache,
+                           std::set<std::string> &files)
+      : source_manager_(source_manager), identifiers_(identifiers),
+        cache_(cache), files_(files) {}
+
+  void LexedFileChanged(clang::FileID FID, LexedFileChangeReason Reason,
+                        clang::SrcMgr::CharacteristicKind FileType,
+                        clang::FileID PrevFID,
+                        clang::SourceLocation Loc) override;
+};
+}
+
+#endif
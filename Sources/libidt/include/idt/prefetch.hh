@@ -0,0 +1,49 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_prefetch_hh
+#define idt_prefetch_hh
+
+#include "idt/file_cache.hh"
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <thread>
+#include <vector>
+
+namespace idt {
+// Reads the files which the analysis of a source is likely to read into a file
+// cache on a background thread, so that reading them overlaps the analysis of
+// the previous source rather than adding to it. The files are the source and
+// the headers which it includes, found by scanning the files for include
+// directives and resolving them against the directory of the including file
+// and the include paths of the compile command. Conditional compilation is
+// not evaluated, so a header may be read which is not used.
+class prefetcher {
+  file_cache &cache_;
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs_;
+  std::thread thread_;
+
+  void run(const std::vector<clang::tooling::CompileCommand> &commands);
+
+public:
+  prefetcher(file_cache &cache,
+             llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs)
+      : cache_(cache), fs_(std::move(fs)) {}
+
+  prefetcher(const prefetcher &) = delete;
+  prefetcher &operator=(const prefetcher &) = delete;
+
+  ~prefetcher() { wait(); }
+
+  // Start reading the files of the compile commands of the next source, once
+  // those of the previous one have been read.
+  void start(std::vector<clang::tooling::CompileCommand> commands);
+
+  void wait();
+};
+}
+
+#endif
@@ -0,0 +1,84 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_profile_hh
+#define idt_profile_hh
+
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace idt {
+// Accumulates the time spent processing each header across the translation
+// units of a run.
+class header_profile {
+  struct timing {
+    // The time spent on the header, including and excluding the headers which
+    // it includes.
+    std::chrono::nanoseconds inclusive{};
+    std::chrono::nanoseconds exclusive{};
+
+    // The number of times the header was entered.
+    unsigned count = 0;
+  };
+
+  std::map<std::string, timing> timings_;
+
+public:
+  void add(llvm::StringRef header, std::chrono::nanoseconds inclusive,
+           std::chrono::nanoseconds exclusive);
+
+  // Add the times recorded by another profile, e.g. of another configuration.
+  void merge(const header_profile &other);
+
+  // Print the `limit` most expensive headers, ordered by their exclusive time.
+  void print(llvm::raw_ostream &os, unsigned limit) const;
+};
+
+// Attributes the time that each header spends at the top of the lexer stack to
+// it. As the parser pulls tokens from the preprocessor, this covers the time to
+// lex, preprocess and parse the contents of the header. Template
+// instantiations performed at the end of the translation unit are not
+// attributed to any header.
+class header_profiler : public clang::PPCallbacks {
+  using clock = std::chrono::steady_clock;
+
+  struct frame {
+    // The name of the header, empty for the main file and for buffers which
+    // are not backed by a file.
+    std::string name;
+
+    clock::time_point start;
+
+    // The time spent in the headers included by this one.
+    clock::duration children{};
+  };
+
+  const clang::SourceManager &source_manager_;
+  header_profile &profile_;
+  std::vector<frame> stack_;
+
+  void enter(clang::FileID id);
+  void exit();
+
+public:
+  header_profiler(const clang::SourceManager &source_manager,
+                  header_profile &profile)
+      : source_manager_(source_manager), profile_(profile) {}
+
+  void LexedFileChanged(clang::FileID FID, LexedFileChangeReason Reason,
+                        clang::SrcMgr::CharacteristicKind FileType,
+                        clang::FileID PrevFID,
+                        clang::SourceLocation Loc) override;
+
+  void EndOfMainFile() override;
+};
+}
+
+#endif
@@ -0,0 +1,84 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_reproducer_hh
+#define idt_reproducer_hh
+
+#include "idt/idt.hh"
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace idt {
+// The files examined and read by the analysis of a translation unit, which
+// are written with its compile commands and options so that the analysis can
+// be replayed without the checkout or the compilation database. The layout of
+// the directory is:
+//
+//   compile_commands.json  the compile commands of the source
+//   options.json           the options of the analysis
+//   files.json             the path and type of each file examined, and the
+//                          name of its contents if it was read
+//   files/<n>              the contents of each file read
+class reproducer {
+  struct file {
+    llvm::sys::fs::file_type type;
+
+    // The contents, if the file was read rather than only examined.
+    std::unique_ptr<llvm::MemoryBuffer> contents;
+  };
+
+  // The files, keyed by their absolute path.
+  std::map<std::string, file> files_;
+
+  friend class recording_file_system;
+
+public:
+  std::size_t size() const { return files_.size(); }
+
+  llvm::Error write(llvm::StringRef directory,
+                    llvm::ArrayRef<clang::tooling::CompileCommand> commands,
+                    const options &options) const;
+};
+
+// A file system which records the files examined and read into a reproducer.
+// The analysis must not be run concurrently.
+class recording_file_system : public llvm::vfs::ProxyFileSystem {
+  reproducer &reproducer_;
+
+  std::string get_absolute_path(const llvm::Twine &path);
+
+public:
+  recording_file_system(reproducer &reproducer,
+                        llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs)
+      : llvm::vfs::ProxyFileSystem(std::move(fs)), reproducer_(reproducer) {}
+
+  llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine &path) override;
+
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+  openFileForRead(const llvm::Twine &path) override;
+};
+
+// Read the options of the reproducer in `directory`.
+llvm::Expected<options> read_reproducer_options(llvm::StringRef directory);
+
+// Read the files of the reproducer in `directory` into an in-memory file
+// system, which contains nothing else.
+llvm::Expected<llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>>
+read_reproducer_files(llvm::StringRef directory);
+}
+
+#endif
@@ -0,0 +1,79 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef idt_snapshot_hh
+#define idt_snapshot_hh
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Mangle.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace idt {
+// The public interface declarations of a run, identified by their USR, which
+// is stable across revisions. This is written as a file which can be compared
+// without reparsing the sources.
+class interface_snapshot {
+  struct entry {
+    std::string name;
+    std::string mangled_name;
+    std::uint64_t signature;
+    bool exported;
+  };
+
+  // The declarations, keyed by their USR.
+  std::map<std::string, entry> entries_;
+
+public:
+  // Add a declaration, which is exported if `exported` is set, or would be by
+  // the suggested annotation otherwise.
+  void add(clang::MangleContext &mangler, const clang::NamedDecl *D,
+           bool exported);
+
+  // Add the declarations of another snapshot, e.g. of another configuration.
+  void merge(const interface_snapshot &other);
+
+  // Write the snapshot to `path`.
+  llvm::Error write(llvm::StringRef path) const;
+};
+
+// A snapshot which is mapped from a file. The layout of the file is:
+//
+//   header    the magic `IDTS`, the version and the number of records
+//   records   the fixed size records, ordered by USR
+//   strings   the USRs, names and mangled names referenced by the records
+//
+// All values are little-endian, so the records are used in place.
+class interface_snapshot_file {
+  std::unique_ptr<llvm::MemoryBuffer> buffer_;
+
+  explicit interface_snapshot_file(std::unique_ptr<llvm::MemoryBuffer> buffer)
+      : buffer_(std::move(buffer)) {}
+
+public:
+  static llvm::Expected<interface_snapshot_file> open(llvm::StringRef path);
+
+  std::size_t size() const;
+
+  llvm::StringRef usr(std::size_t index) const;
+  llvm::StringRef name(std::size_t index) const;
+  llvm::StringRef mangled_name(std::size_t index) const;
+  std::uint64_t signature(std::size_t index) const;
+  bool exported(std::size_t index) const;
+};
+
+// Print the declarations which were added or removed, or whose signature or
+// export status changed, from `before` to `after`. Returns the number of
+// differences.
+unsigned diff(const interface_snapshot_file &before,
+              const interface_snapshot_file &after, llvm::raw_ostream &os);
+}
+
+#endif
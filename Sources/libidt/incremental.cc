@@ -0,0 +1,97 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/incremental.hh"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <system_error>
+
+namespace idt {
+std::uint64_t get_digest(llvm::StringRef contents) {
+  return llvm::xxh3_64bits(contents);
+}
+
+bool incremental_record::is_current(llvm::StringRef path,
+                                    std::uint64_t command) {
+  const auto recorded = sources_.find(path.str());
+  if (recorded == sources_.end() || recorded->second.command != command)
+    return false;
+
+  for (const auto &file : recorded->second.files) {
+    auto [digest, inserted] = digests_.try_emplace(file.first);
+    if (inserted) {
+      llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+          llvm::MemoryBuffer::getFile(file.first, /*IsText=*/false,
+                                      /*RequiresNullTerminator=*/false);
+      if (buffer)
+        digest->second = get_digest((*buffer)->getBuffer());
+    }
+    if (digest->second != file.second)
+      return false;
+  }
+  return true;
+}
+
+void incremental_record::update(llvm::StringRef path, std::uint64_t command,
+                                std::map<std::string, std::uint64_t> files) {
+  sources_[path.str()] = source{command, std::move(files)};
+}
+
+llvm::Error incremental_record::load(llvm::StringRef path) {
+  if (!llvm::sys::fs::exists(path))
+    return llvm::Error::success();
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/true);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(), "unable to read '%s': %s",
+                                   path.str().c_str(),
+                                   buffer.getError().message().c_str());
+
+  llvm::SmallVector<llvm::StringRef, 0> lines;
+  (*buffer)->getBuffer().split(lines, '\n', /*MaxSplit=*/-1,
+                               /*KeepEmpty=*/false);
+
+  source *current = nullptr;
+  for (llvm::StringRef line : lines) {
+    auto [kind, rest] = line.rtrim().split(' ');
+    auto [value, name] = rest.split(' ');
+
+    std::uint64_t digest;
+    if (name.empty() || value.getAsInteger(16, digest) ||
+        (kind != "source" && kind != "file") || (kind == "file" && !current))
+      return llvm::createStringError(std::errc::invalid_argument,
+                                     "invalid incremental record '%s': '%s'",
+                                     path.str().c_str(), line.str().c_str());
+
+    if (kind == "source")
+      current = &(sources_[name.str()] = source{digest, {}});
+    else
+      current->files[name.str()] = digest;
+  }
+  return llvm::Error::success();
+}
+
+llvm::Error incremental_record::save(llvm::StringRef path) const {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Text);
+  if (ec)
+    return llvm::createStringError(ec, "unable to write '%s': %s",
+                                   path.str().c_str(), ec.message().c_str());
+
+  for (const auto &entry : sources_) {
+    os << "source " << llvm::format_hex_no_prefix(entry.second.command, 16)
+       << ' ' << entry.first << '\n';
+    for (const auto &file : entry.second.files)
+      os << "file " << llvm::format_hex_no_prefix(file.second, 16) << ' '
+         << file.first << '\n';
+  }
+  return llvm::Error::success();
+}
+}
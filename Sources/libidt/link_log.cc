@@ -0,0 +1,259 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/link_log.hh"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Demangle/Demangle.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+bool is_identifier_char(char c) {
+  return llvm::isAlnum(c) || c == '_' || c == '$';
+}
+
+// Remove the template arguments from the last component of a qualified name,
+// e.g. `ns::f<int>` becomes `ns::f`. The template arguments of the enclosing
+// classes are retained, as they are part of the qualified name of a member.
+llvm::StringRef drop_template_arguments(llvm::StringRef name) {
+  if (!name.ends_with(">") || name.ends_with("operator>") ||
+      name.ends_with("operator>>") || name.ends_with("operator->"))
+    return name;
+
+  int depth = 0;
+  for (size_t index = name.size(); index-- > 0;) {
+    if (name[index] == '>')
+      ++depth;
+    else if (name[index] == '<' && --depth == 0)
+      return name.take_front(index);
+  }
+  return name;
+}
+
+// Extract the qualified name from a demangled symbol, e.g. `ns::foo::bar` from
+// `public: void __cdecl ns::foo::bar(int)` or from `ns::foo::bar(int) const`.
+// An empty name is returned for symbols which cannot be exported.
+std::string get_qualified_name(llvm::StringRef symbol) {
+  symbol = symbol.trim();
+
+  // The virtual table and type information are emitted with the class.
+  for (llvm::StringRef prefix :
+       {"vtable for ", "VTT for ", "typeinfo for ", "typeinfo name for "})
+    if (symbol.consume_front(prefix))
+      return drop_template_arguments(symbol).str();
+
+  symbol.consume_front("__declspec(dllimport) ");
+  symbol.consume_front("const ");
+  for (llvm::StringRef suffix : {"::`vftable'", "::`vbtable'"})
+    if (symbol.consume_back(suffix))
+      return drop_template_arguments(symbol).str();
+
+  // Find the parameter list, if any, skipping over the template arguments and
+  // the spelling of operators.
+  size_t end = symbol.size();
+  int depth = 0;
+  for (size_t index = 0; index < symbol.size();) {
+    llvm::StringRef rest = symbol.drop_front(index);
+    if (rest.starts_with("operator") &&
+        (index == 0 || !is_identifier_char(symbol[index - 1])) &&
+        (rest.size() == 8 || !is_identifier_char(rest[8]))) {
+      index += 8;
+      rest = symbol.drop_front(index);
+      if (rest.starts_with("()") || rest.starts_with("[]"))
+        index += 2;
+      else
+        while (index < symbol.size() &&
+               llvm::StringRef("<>=!+-*/%^&|~,").contains(symbol[index]))
+          ++index;
+      continue;
+    }
+
+    const char c = symbol[index];
+    if (c == '<') {
+      ++depth;
+    } else if (c == '>') {
+      --depth;
+    } else if (c == '(' && depth == 0) {
+      if (rest.starts_with("(anonymous namespace)"))
+        return {};
+      end = index;
+      break;
+    }
+    ++index;
+  }
+
+  // The name follows the return type and calling convention, if any.
+  const llvm::StringRef prefix = symbol.take_front(end).rtrim();
+  size_t start = 0;
+  depth = 0;
+  for (size_t index = prefix.size(); index-- > 0;) {
+    const char c = prefix[index];
+    if (c == '>') {
+      ++depth;
+    } else if (c == '<') {
+      --depth;
+    } else if (c == ' ' && depth <= 0) {
+      start = index + 1;
+      break;
+    }
+  }
+
+  const llvm::StringRef name = prefix.drop_front(start);
+  if (name.contains('`'))
+    return {};
+  return drop_template_arguments(name).str();
+}
+
+// Add the undefined symbol as it was spelt in the log. Apple targets prefix
+// all symbols with an underscore, which is removed if the symbol has not been
+// demangled by the linker.
+void add_symbol(std::set<std::string> &symbols, llvm::StringRef symbol,
+                bool apple = false) {
+  symbol = symbol.trim();
+  symbol.consume_front("__imp_");
+  if (apple && symbol.starts_with("_") &&
+      (symbol.starts_with("__Z") ||
+       !(symbol.contains("::") || symbol.contains('('))))
+    symbol = symbol.drop_front();
+
+  const std::string name = get_qualified_name(llvm::demangle(symbol.str()));
+  if (!name.empty())
+    symbols.insert(name);
+}
+}
+
+namespace idt {
+std::set<std::string> parse_link_log(llvm::StringRef log) {
+  std::set<std::string> symbols;
+
+  llvm::SmallVector<llvm::StringRef, 0> lines;
+  log.split(lines, '\n');
+
+  // ld64 lists the undefined symbols following a heading, as
+  //   "symbol", referenced from:
+  // followed by the references, which are indented further.
+  bool apple_undefined_symbols = false;
+
+  for (llvm::StringRef line : lines) {
+    line = line.rtrim();
+
+    if (apple_undefined_symbols) {
+      const llvm::StringRef entry = line.ltrim();
+      if (entry.starts_with("\"") && entry.contains("\", referenced from")) {
+        add_symbol(symbols,
+                   entry.drop_front().split("\", referenced from").first,
+                   /*apple=*/true);
+        continue;
+      }
+      if (line.empty() || line.starts_with(" "))
+        continue;
+      apple_undefined_symbols = false;
+    }
+
+    if (line.starts_with("Undefined symbols for architecture")) {
+      apple_undefined_symbols = true;
+      continue;
+    }
+
+    // link.exe:
+    //   error LNK2019: unresolved external symbol "demangled" (mangled)
+    //   referenced in function ...
+    size_t index = line.find("unresolved external symbol ");
+    if (index != llvm::StringRef::npos) {
+      llvm::StringRef symbol =
+          line.drop_front(index + strlen("unresolved external symbol "));
+      if (symbol.starts_with("\"") && symbol.contains("\" ("))
+        symbol = symbol.split("\" (").second.split(')').first;
+      else
+        symbol = symbol.split(" referenced in ").first;
+      add_symbol(symbols, symbol);
+      continue;
+    }
+
+    // lld:
+    //   error: undefined symbol: symbol
+    index = line.find("undefined symbol: ");
+    if (index != llvm::StringRef::npos) {
+      add_symbol(symbols, line.drop_front(index + strlen("undefined symbol: ")),
+                 line.contains("ld64.lld"));
+      continue;
+    }
+
+    // GNU ld and gold:
+    //   undefined reference to `symbol'
+    index = line.find("undefined reference to ");
+    if (index != llvm::StringRef::npos) {
+      llvm::StringRef symbol =
+          line.drop_front(index + strlen("undefined reference to "));
+      if (symbol.consume_front("`") || symbol.consume_front("'"))
+        symbol = symbol.take_front(symbol.rfind('\''));
+      add_symbol(symbols, symbol);
+      continue;
+    }
+  }
+
+  return symbols;
+}
+
+std::vector<std::string>
+get_symbol_identifiers(const std::set<std::string> &symbols) {
+  std::set<std::string> identifiers;
+  for (llvm::StringRef symbol : symbols) {
+    // Find the last component, skipping over any template arguments of the
+    // enclosing classes.
+    size_t start = 0;
+    int depth = 0;
+    for (size_t index = symbol.size(); index-- > 0;) {
+      const char c = symbol[index];
+      if (c == '>') {
+        ++depth;
+      } else if (c == '<') {
+        --depth;
+      } else if (c == ':' && depth <= 0) {
+        start = index + 1;
+        break;
+      }
+    }
+
+    llvm::StringRef identifier = symbol.drop_front(start);
+    identifier.consume_front("~");
+    if (identifier.starts_with("operator"))
+      identifier = "operator";
+    if (!identifier.empty())
+      identifiers.insert(identifier.str());
+  }
+  return {identifiers.begin(), identifiers.end()};
+}
+
+void symbol_reference_scanner::LexedFileChanged(
+    clang::FileID FID, LexedFileChangeReason Reason,
+    clang::SrcMgr::CharacteristicKind FileType, clang::FileID PrevFID,
+    clang::SourceLocation Loc) {
+  if (Reason != LexedFileChangeReason::EnterFile)
+    return;
+
+  // System headers are never annotated.
+  if (FileType != clang::SrcMgr::C_User)
+    return;
+
+  const auto entry = source_manager_.getFileEntryRefForID(FID);
+  if (!entry)
+    return;
+
+  const llvm::StringRef name = entry->getName();
+  auto [cached, inserted] = cache_.try_emplace(name, false);
+  if (inserted) {
+    const llvm::StringRef buffer = source_manager_.getBufferData(FID);
+    cached->second = std::any_of(identifiers_.begin(), identifiers_.end(),
+                                 [buffer](const std::string &identifier) {
+                                   return buffer.contains(identifier);
+                                 });
+  }
+
+  if (cached->second)
+    files_.insert(name.str());
+}
+}
@@ -0,0 +1,145 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/prefetch.hh"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Path.h"
+
+#include <cstddef>
+#include <string>
+#include <tuple>
+
+namespace {
+// The maximum number of files read for a source, which bounds the work for a
+// source whose includes cannot be resolved precisely.
+constexpr std::size_t kMaxFiles = 4096;
+
+// A file to read, and the directory of the file which included it.
+struct pending {
+  std::string path;
+  bool angled;
+  std::string directory;
+};
+
+std::string resolve(llvm::StringRef directory, llvm::StringRef name) {
+  llvm::SmallString<256> path{name};
+  if (!llvm::sys::path::is_absolute(path)) {
+    path = directory;
+    llvm::sys::path::append(path, name);
+  }
+  llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+  return std::string(path);
+}
+
+// Determine the include paths of a compile command, in the order in which they
+// are searched.
+std::vector<std::string>
+get_include_paths(const clang::tooling::CompileCommand &command) {
+  static constexpr llvm::StringLiteral kOptions[] = {
+      "-I", "/I", "-iquote", "-isystem", "-idirafter", "/external:I",
+  };
+
+  std::vector<std::string> paths;
+  const std::vector<std::string> &arguments = command.CommandLine;
+  for (std::size_t index = 0; index < arguments.size(); ++index) {
+    llvm::StringRef argument = arguments[index];
+    for (llvm::StringRef option : kOptions) {
+      if (!argument.consume_front(option))
+        continue;
+      if (argument.empty() && index + 1 < arguments.size())
+        argument = arguments[++index];
+      if (!argument.empty())
+        paths.push_back(resolve(command.Directory, argument));
+      break;
+    }
+  }
+  return paths;
+}
+
+// Add the files named by the include directives of `contents` to `files`.
+void scan(llvm::StringRef contents, llvm::StringRef directory,
+          std::vector<pending> &files) {
+  while (!contents.empty()) {
+    llvm::StringRef line;
+    std::tie(line, contents) = contents.split('\n');
+
+    line = line.ltrim();
+    if (!line.consume_front("#"))
+      continue;
+    line = line.ltrim();
+    if (!line.consume_front("include_next") && !line.consume_front("include") &&
+        !line.consume_front("import"))
+      continue;
+    line = line.ltrim();
+
+    const bool angled = line.starts_with("<");
+    if (!angled && !line.starts_with("\""))
+      continue;
+    const std::size_t end = line.find(angled ? '>' : '"', 1);
+    if (end == llvm::StringRef::npos)
+      continue;
+    files.push_back({line.substr(1, end - 1).str(), angled, directory.str()});
+  }
+}
+}
+
+namespace idt {
+void prefetcher::run(
+    const std::vector<clang::tooling::CompileCommand> &commands) {
+  for (const clang::tooling::CompileCommand &command : commands) {
+    const std::vector<std::string> include_paths = get_include_paths(command);
+
+    llvm::StringSet<> read;
+    llvm::StringSet<> missing;
+    std::vector<pending> files{
+        {resolve(command.Directory, command.Filename), false, ""}};
+    while (!files.empty() && read.size() < kMaxFiles) {
+      const pending file = std::move(files.back());
+      files.pop_back();
+
+      // A quoted include is searched for relative to the including file first.
+      std::vector<std::string> candidates;
+      if (llvm::sys::path::is_absolute(file.path))
+        candidates.push_back(file.path);
+      else if (!file.angled)
+        candidates.push_back(resolve(file.directory, file.path));
+      if (!llvm::sys::path::is_absolute(file.path))
+        for (const std::string &include_path : include_paths)
+          candidates.push_back(resolve(include_path, file.path));
+
+      for (const std::string &candidate : candidates) {
+        if (read.contains(candidate))
+          break;
+        if (missing.contains(candidate))
+          continue;
+
+        const llvm::MemoryBuffer *buffer = cache_.prefetch(*fs_, candidate);
+        if (!buffer) {
+          missing.insert(candidate);
+          continue;
+        }
+
+        read.insert(candidate);
+        scan(buffer->getBuffer(), llvm::sys::path::parent_path(candidate),
+             files);
+        break;
+      }
+    }
+  }
+}
+
+void prefetcher::start(std::vector<clang::tooling::CompileCommand> commands) {
+  wait();
+  thread_ = std::thread([this, commands = std::move(commands)]() {
+    run(commands);
+  });
+}
+
+void prefetcher::wait() {
+  if (thread_.joinable())
+    thread_.join();
+}
+}
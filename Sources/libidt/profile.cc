@@ -0,0 +1,94 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/profile.hh"
+
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+
+namespace idt {
+void header_profile::add(llvm::StringRef header,
+                         std::chrono::nanoseconds inclusive,
+                         std::chrono::nanoseconds exclusive) {
+  timing &entry = timings_[header.str()];
+  entry.inclusive += inclusive;
+  entry.exclusive += exclusive;
+  ++entry.count;
+}
+
+void header_profile::merge(const header_profile &other) {
+  for (const auto &header : other.timings_) {
+    timing &entry = timings_[header.first];
+    entry.inclusive += header.second.inclusive;
+    entry.exclusive += header.second.exclusive;
+    entry.count += header.second.count;
+  }
+}
+
+void header_profile::print(llvm::raw_ostream &os, unsigned limit) const {
+  std::vector<std::pair<std::string, timing>> headers(timings_.begin(),
+                                                      timings_.end());
+  std::stable_sort(headers.begin(), headers.end(),
+                   [](const auto &lhs, const auto &rhs) {
+                     return lhs.second.exclusive > rhs.second.exclusive;
+                   });
+  if (headers.size() > limit)
+    headers.resize(limit);
+
+  auto milliseconds = [](std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  };
+
+  os << "header times (inclusive, exclusive, inclusions):\n";
+  for (const auto &header : headers)
+    os << llvm::format("  %10.3f ms %10.3f ms %6u ",
+                       milliseconds(header.second.inclusive),
+                       milliseconds(header.second.exclusive),
+                       header.second.count)
+       << header.first << '\n';
+}
+
+void header_profiler::enter(clang::FileID id) {
+  std::string name;
+  if (id != source_manager_.getMainFileID())
+    if (const auto entry = source_manager_.getFileEntryRefForID(id))
+      name = entry->getName().str();
+
+  stack_.push_back({std::move(name), clock::now()});
+}
+
+void header_profiler::exit() {
+  if (stack_.empty())
+    return;
+
+  const frame current = std::move(stack_.back());
+  stack_.pop_back();
+
+  const clock::duration inclusive = clock::now() - current.start;
+  if (!stack_.empty())
+    stack_.back().children += inclusive;
+
+  if (!current.name.empty())
+    profile_.add(current.name, inclusive, inclusive - current.children);
+}
+
+void header_profiler::LexedFileChanged(
+    clang::FileID FID, LexedFileChangeReason Reason,
+    clang::SrcMgr::CharacteristicKind FileType, clang::FileID PrevFID,
+    clang::SourceLocation Loc) {
+  switch (Reason) {
+  case LexedFileChangeReason::EnterFile:
+    enter(FID);
+    break;
+  case LexedFileChangeReason::ExitFile:
+    exit();
+    break;
+  }
+}
+
+void header_profiler::EndOfMainFile() {
+  while (!stack_.empty())
+    exit();
+}
+}
@@ -0,0 +1,320 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/reproducer.hh"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <system_error>
+
+namespace {
+llvm::json::Value to_json(const idt::options &options) {
+  llvm::json::Array components;
+  for (const idt::component &component : options.components)
+    components.push_back(llvm::json::Object{
+        {"pattern", component.pattern},
+        {"export_macro", component.export_macro},
+        {"include_header", component.include_header},
+    });
+
+  return llvm::json::Object{
+      {"export_macro", options.export_macro},
+      {"include_header", options.include_header},
+      {"components", std::move(components)},
+      {"header_extensions", options.header_extensions},
+      {"header_filter", options.header_filter},
+      {"ignored_symbols",
+       std::vector<std::string>(options.ignored_symbols.begin(),
+                                options.ignored_symbols.end())},
+      {"target_symbols",
+       std::vector<std::string>(options.target_symbols.begin(),
+                                options.target_symbols.end())},
+      {"over_exports", options.over_exports},
+      {"private_headers", options.private_headers},
+      {"internal_namespaces",
+       std::vector<std::string>(options.internal_namespaces.begin(),
+                                options.internal_namespaces.end())},
+      {"export_report", options.export_report},
+      {"export_budget", options.export_budget},
+      {"export_report_limit", options.export_report_limit},
+      {"extern_templates", options.extern_templates},
+      {"extern_template_macro", options.extern_template_macro},
+      {"extern_template_threshold", options.extern_template_threshold},
+      {"extern_template_limit", options.extern_template_limit},
+      {"profile_headers", options.profile_headers},
+      {"profile_headers_limit", options.profile_headers_limit},
+      {"stats", options.stats},
+      {"explain", options.explain},
+  };
+}
+
+bool map(llvm::json::ObjectMapper &mapper, llvm::StringLiteral name,
+         std::set<std::string> &value) {
+  std::vector<std::string> values(value.begin(), value.end());
+  if (!mapper.mapOptional(name, values))
+    return false;
+  value = {values.begin(), values.end()};
+  return true;
+}
+
+bool map(llvm::json::ObjectMapper &mapper, llvm::StringLiteral name,
+         unsigned &value) {
+  std::uint64_t number = value;
+  if (!mapper.mapOptional(name, number))
+    return false;
+  value = static_cast<unsigned>(number);
+  return true;
+}
+
+template <typename Value_>
+bool map(llvm::json::ObjectMapper &mapper, llvm::StringLiteral name,
+         Value_ &value) {
+  return mapper.mapOptional(name, value);
+}
+}
+
+namespace idt {
+bool fromJSON(const llvm::json::Value &value, component &component,
+              llvm::json::Path path) {
+  llvm::json::ObjectMapper mapper(value, path);
+  return mapper && mapper.map("pattern", component.pattern) &&
+         mapper.map("export_macro", component.export_macro) &&
+         mapper.mapOptional("include_header", component.include_header);
+}
+
+// The options which are not recorded keep their defaults: the suggested
+// changes are not applied, as the files only exist in memory, and the
+// configuration is part of the compile commands.
+bool fromJSON(const llvm::json::Value &value, options &options,
+              llvm::json::Path path) {
+  llvm::json::ObjectMapper mapper(value, path);
+  return mapper && map(mapper, "export_macro", options.export_macro) &&
+         map(mapper, "include_header", options.include_header) &&
+         map(mapper, "components", options.components) &&
+         map(mapper, "header_extensions", options.header_extensions) &&
+         map(mapper, "header_filter", options.header_filter) &&
+         map(mapper, "ignored_symbols", options.ignored_symbols) &&
+         map(mapper, "target_symbols", options.target_symbols) &&
+         map(mapper, "over_exports", options.over_exports) &&
+         map(mapper, "private_headers", options.private_headers) &&
+         map(mapper, "internal_namespaces", options.internal_namespaces) &&
+         map(mapper, "export_report", options.export_report) &&
+         map(mapper, "export_budget", options.export_budget) &&
+         map(mapper, "export_report_limit", options.export_report_limit) &&
+         map(mapper, "extern_templates", options.extern_templates) &&
+         map(mapper, "extern_template_macro",
+             options.extern_template_macro) &&
+         map(mapper, "extern_template_threshold",
+             options.extern_template_threshold) &&
+         map(mapper, "extern_template_limit", options.extern_template_limit) &&
+         map(mapper, "profile_headers", options.profile_headers) &&
+         map(mapper, "profile_headers_limit", options.profile_headers_limit) &&
+         map(mapper, "stats", options.stats) &&
+         map(mapper, "explain", options.explain);
+}
+}
+
+namespace {
+llvm::Error write_file(llvm::StringRef path, llvm::StringRef contents) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_None);
+  if (ec)
+    return llvm::createStringError(ec, "unable to write '%s': %s",
+                                   path.str().c_str(), ec.message().c_str());
+  os << contents;
+  return llvm::Error::success();
+}
+
+llvm::Error write_json(llvm::StringRef path, const llvm::json::Value &value) {
+  return write_file(path, llvm::formatv("{0:2}\n", value).str());
+}
+
+llvm::Expected<llvm::json::Value> read_json(llvm::StringRef path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/true);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(), "unable to read '%s': %s",
+                                   path.str().c_str(),
+                                   buffer.getError().message().c_str());
+
+  llvm::Expected<llvm::json::Value> value =
+      llvm::json::parse((*buffer)->getBuffer());
+  if (!value)
+    return llvm::createStringError(std::errc::invalid_argument,
+                                   "invalid reproducer '%s': %s",
+                                   path.str().c_str(),
+                                   llvm::toString(value.takeError()).c_str());
+  return value;
+}
+
+std::string join(llvm::StringRef directory, llvm::StringRef name) {
+  llvm::SmallString<256> path{directory};
+  llvm::sys::path::append(path, name);
+  return std::string(path);
+}
+}
+
+namespace idt {
+llvm::Error
+reproducer::write(llvm::StringRef directory,
+                  llvm::ArrayRef<clang::tooling::CompileCommand> commands,
+                  const options &options) const {
+  const std::string contents = join(directory, "files");
+  if (std::error_code ec = llvm::sys::fs::create_directories(contents))
+    return llvm::createStringError(ec, "unable to create '%s': %s",
+                                   contents.c_str(), ec.message().c_str());
+
+  llvm::json::Array database;
+  for (const clang::tooling::CompileCommand &command : commands) {
+    llvm::json::Object entry{
+        {"directory", command.Directory},
+        {"file", command.Filename},
+        {"arguments", command.CommandLine},
+    };
+    if (!command.Output.empty())
+      entry["output"] = command.Output;
+    database.push_back(std::move(entry));
+  }
+  if (llvm::Error error = write_json(join(directory, "compile_commands.json"),
+                                     std::move(database)))
+    return error;
+
+  if (llvm::Error error =
+          write_json(join(directory, "options.json"), to_json(options)))
+    return error;
+
+  llvm::json::Array files;
+  unsigned count = 0;
+  for (const auto &item : files_) {
+    const file &entry = item.second;
+    llvm::json::Object record{
+        {"path", item.first},
+        {"type", entry.type == llvm::sys::fs::file_type::directory_file
+                     ? "directory"
+                     : "file"},
+    };
+    if (entry.contents) {
+      const std::string name = "files/" + std::to_string(count++);
+      if (llvm::Error error = write_file(join(directory, name),
+                                         entry.contents->getBuffer()))
+        return error;
+      record["contents"] = name;
+    }
+    files.push_back(std::move(record));
+  }
+  return write_json(join(directory, "files.json"), std::move(files));
+}
+
+std::string recording_file_system::get_absolute_path(const llvm::Twine &path) {
+  llvm::SmallString<256> name;
+  path.toVector(name);
+  if (!makeAbsolute(name))
+    llvm::sys::path::remove_dots(name);
+  return std::string(name);
+}
+
+llvm::ErrorOr<llvm::vfs::Status>
+recording_file_system::status(const llvm::Twine &path) {
+  llvm::ErrorOr<llvm::vfs::Status> status = getUnderlyingFS().status(path);
+  if (status)
+    reproducer_.files_.try_emplace(
+        get_absolute_path(path), reproducer::file{status->getType(), nullptr});
+  return status;
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+recording_file_system::openFileForRead(const llvm::Twine &path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> file =
+      getUnderlyingFS().openFileForRead(path);
+  if (!file)
+    return file;
+
+  reproducer::file &entry = reproducer_.files_[get_absolute_path(path)];
+  if (entry.contents)
+    return file;
+
+  llvm::ErrorOr<llvm::vfs::Status> status = (*file)->status();
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      (*file)->getBuffer(path);
+  if (!status || !buffer)
+    return file;
+
+  entry.type = status->getType();
+  entry.contents = llvm::MemoryBuffer::getMemBufferCopy(
+      (*buffer)->getBuffer(), (*buffer)->getBufferIdentifier());
+
+  // The contents have been consumed, so the file is read again for the
+  // analysis.
+  return getUnderlyingFS().openFileForRead(path);
+}
+
+llvm::Expected<options> read_reproducer_options(llvm::StringRef directory) {
+  llvm::Expected<llvm::json::Value> value =
+      read_json(join(directory, "options.json"));
+  if (!value)
+    return value.takeError();
+
+  options result;
+  llvm::json::Path::Root root("options.json");
+  if (!fromJSON(*value, result, root))
+    return root.getError();
+  return result;
+}
+
+llvm::Expected<llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>>
+read_reproducer_files(llvm::StringRef directory) {
+  llvm::Expected<llvm::json::Value> value =
+      read_json(join(directory, "files.json"));
+  if (!value)
+    return value.takeError();
+
+  const llvm::json::Array *files = value->getAsArray();
+  if (!files)
+    return llvm::createStringError(std::errc::invalid_argument,
+                                   "invalid reproducer '%s': expected a list "
+                                   "of files",
+                                   directory.str().c_str());
+
+  auto fs = llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>();
+  for (const llvm::json::Value &item : *files) {
+    const llvm::json::Object *record = item.getAsObject();
+    std::optional<llvm::StringRef> path =
+        record ? record->getString("path") : std::nullopt;
+    if (!path)
+      return llvm::createStringError(std::errc::invalid_argument,
+                                     "invalid reproducer '%s': expected the "
+                                     "path of a file",
+                                     directory.str().c_str());
+
+    if (record->getString("type") == "directory") {
+      fs->addFile(*path, 0, llvm::MemoryBuffer::getMemBuffer(""),
+                  std::nullopt, std::nullopt,
+                  llvm::sys::fs::file_type::directory_file);
+      continue;
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> contents =
+        llvm::MemoryBuffer::getMemBuffer("", *path);
+    if (std::optional<llvm::StringRef> name = record->getString("contents")) {
+      const std::string location = join(directory, *name);
+      llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+          llvm::MemoryBuffer::getFile(location, /*IsText=*/false);
+      if (!buffer)
+        return llvm::createStringError(buffer.getError(),
+                                       "unable to read '%s': %s",
+                                       location.c_str(),
+                                       buffer.getError().message().c_str());
+      contents = std::move(*buffer);
+    }
+    fs->addFile(*path, 0, std::move(contents));
+  }
+  return fs;
+}
+}
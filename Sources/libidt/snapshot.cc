@@ -0,0 +1,332 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/snapshot.hh"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/GlobalDecl.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+namespace {
+using llvm::support::ulittle32_t;
+using llvm::support::ulittle64_t;
+
+constexpr char kMagic[4] = {'I', 'D', 'T', 'S'};
+constexpr std::uint32_t kVersion = 1;
+
+struct header {
+  char magic[4];
+  ulittle32_t version;
+  ulittle32_t count;
+  ulittle32_t reserved;
+};
+
+struct record {
+  // The offsets are relative to the start of the strings.
+  ulittle32_t usr_offset;
+  ulittle32_t usr_size;
+  ulittle32_t name_offset;
+  ulittle32_t name_size;
+  ulittle32_t mangled_name_offset;
+  ulittle32_t mangled_name_size;
+  ulittle64_t signature;
+  ulittle32_t flags;
+  ulittle32_t reserved;
+};
+
+static_assert(sizeof(header) == 16, "unexpected padding in the header");
+static_assert(sizeof(record) == 40, "unexpected padding in the record");
+
+enum : std::uint32_t {
+  kExported = 1 << 0,
+};
+
+// The text from which the signature hash is computed. This covers the parts of
+// the declaration which affect its ABI: the type of a function or variable,
+// and the bases, fields, virtual methods and layout of a class.
+std::string get_signature(const clang::NamedDecl *D) {
+  std::string signature;
+  llvm::raw_string_ostream os(signature);
+
+  if (const auto *FD = llvm::dyn_cast<clang::FunctionDecl>(D)) {
+    os << FD->getType().getCanonicalType().getAsString();
+    if (const auto *MD = llvm::dyn_cast<clang::CXXMethodDecl>(FD))
+      os << (MD->isVirtual() ? " virtual" : "")
+         << (MD->isStatic() ? " static" : "");
+    return signature;
+  }
+
+  if (const auto *VD = llvm::dyn_cast<clang::VarDecl>(D)) {
+    os << VD->getType().getCanonicalType().getAsString();
+    return signature;
+  }
+
+  const auto *RD = llvm::dyn_cast<clang::CXXRecordDecl>(D);
+  if (!RD || !RD->hasDefinition())
+    return signature;
+  RD = RD->getDefinition();
+
+  for (const clang::CXXBaseSpecifier &base : RD->bases())
+    os << "base " << (base.isVirtual() ? "virtual " : "")
+       << base.getType().getCanonicalType().getAsString() << ';';
+  for (const clang::FieldDecl *FD : RD->fields())
+    os << "field " << FD->getType().getCanonicalType().getAsString() << ' '
+       << FD->getName() << ';';
+  for (const clang::CXXMethodDecl *MD : RD->methods())
+    if (MD->isVirtual())
+      os << "virtual " << MD->getNameAsString() << ' '
+         << MD->getType().getCanonicalType().getAsString() << ';';
+
+  if (!RD->isDependentType() && !RD->isInvalidDecl()) {
+    const clang::ASTRecordLayout &layout =
+        RD->getASTContext().getASTRecordLayout(RD);
+    os << "size " << layout.getSize().getQuantity() << " align "
+       << layout.getAlignment().getQuantity();
+  }
+  return signature;
+}
+
+// The name of the symbol for a function or variable. Constructors and
+// destructors are identified by their complete object variant. Classes do not
+// have a single symbol.
+std::string get_mangled_name(clang::MangleContext &mangler,
+                             const clang::NamedDecl *D) {
+  clang::GlobalDecl GD;
+  if (const auto *CD = llvm::dyn_cast<clang::CXXConstructorDecl>(D))
+    GD = clang::GlobalDecl(CD, clang::Ctor_Complete);
+  else if (const auto *DD = llvm::dyn_cast<clang::CXXDestructorDecl>(D))
+    GD = clang::GlobalDecl(DD, clang::Dtor_Complete);
+  else if (const auto *FD = llvm::dyn_cast<clang::FunctionDecl>(D))
+    GD = clang::GlobalDecl(FD);
+  else if (const auto *VD = llvm::dyn_cast<clang::VarDecl>(D))
+    GD = clang::GlobalDecl(VD);
+  else
+    return {};
+
+  if (!mangler.shouldMangleDeclName(D))
+    return D->getNameAsString();
+
+  std::string name;
+  llvm::raw_string_ostream os(name);
+  mangler.mangleName(GD, os);
+  return os.str();
+}
+
+const record &get_record(const llvm::MemoryBuffer &buffer, std::size_t index) {
+  return reinterpret_cast<const record *>(buffer.getBufferStart() +
+                                          sizeof(header))[index];
+}
+
+llvm::StringRef get_string(const llvm::MemoryBuffer &buffer,
+                           std::uint32_t offset, std::uint32_t size) {
+  const auto *prefix = reinterpret_cast<const header *>(buffer.getBufferStart());
+  const char *strings = buffer.getBufferStart() + sizeof(header) +
+                        std::size_t{prefix->count} * sizeof(record);
+  return {strings + offset, size};
+}
+
+llvm::Error invalid_snapshot(llvm::StringRef path, const char *reason) {
+  return llvm::createStringError(std::errc::invalid_argument,
+                                 "invalid snapshot '%s': %s",
+                                 path.str().c_str(), reason);
+}
+}
+
+namespace idt {
+void interface_snapshot::add(clang::MangleContext &mangler,
+                             const clang::NamedDecl *D, bool exported) {
+  llvm::SmallString<128> usr;
+  if (clang::index::generateUSRForDecl(D, usr))
+    return;
+
+  // Headers are visited by many translation units; the declaration is the
+  // same in each of them.
+  auto [declaration, inserted] = entries_.try_emplace(usr.str().str());
+  if (!inserted) {
+    declaration->second.exported |= exported;
+    return;
+  }
+
+  declaration->second = entry{D->getQualifiedNameAsString(),
+                              get_mangled_name(mangler, D),
+                              llvm::xxh3_64bits(get_signature(D)), exported};
+}
+
+void interface_snapshot::merge(const interface_snapshot &other) {
+  for (const auto &item : other.entries_) {
+    auto [declaration, inserted] = entries_.insert(item);
+    if (!inserted)
+      declaration->second.exported |= item.second.exported;
+  }
+}
+
+llvm::Error interface_snapshot::write(llvm::StringRef path) const {
+  std::string strings;
+  std::vector<record> records;
+  records.reserve(entries_.size());
+
+  auto add_string = [&strings](llvm::StringRef value, ulittle32_t &offset,
+                               ulittle32_t &size) {
+    offset = strings.size();
+    size = value.size();
+    strings.append(value.begin(), value.end());
+  };
+
+  for (const auto &item : entries_) {
+    record value{};
+    add_string(item.first, value.usr_offset, value.usr_size);
+    add_string(item.second.name, value.name_offset, value.name_size);
+    add_string(item.second.mangled_name, value.mangled_name_offset,
+               value.mangled_name_size);
+    value.signature = item.second.signature;
+    value.flags = item.second.exported ? kExported : 0;
+    records.push_back(value);
+  }
+
+  header prefix{};
+  std::memcpy(prefix.magic, kMagic, sizeof(kMagic));
+  prefix.version = kVersion;
+  prefix.count = records.size();
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_None);
+  if (ec)
+    return llvm::createStringError(ec, "unable to write '%s': %s",
+                                   path.str().c_str(), ec.message().c_str());
+
+  os.write(reinterpret_cast<const char *>(&prefix), sizeof(prefix));
+  os.write(reinterpret_cast<const char *>(records.data()),
+           records.size() * sizeof(record));
+  os << strings;
+  return llvm::Error::success();
+}
+
+llvm::Expected<interface_snapshot_file>
+interface_snapshot_file::open(llvm::StringRef path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(), "unable to read '%s': %s",
+                                   path.str().c_str(),
+                                   buffer.getError().message().c_str());
+
+  const llvm::StringRef contents = (*buffer)->getBuffer();
+  if (contents.size() < sizeof(header))
+    return invalid_snapshot(path, "truncated header");
+
+  const auto *prefix = reinterpret_cast<const header *>(contents.data());
+  if (std::memcmp(prefix->magic, kMagic, sizeof(kMagic)))
+    return invalid_snapshot(path, "not a snapshot");
+  if (prefix->version != kVersion)
+    return invalid_snapshot(path, "unsupported version");
+
+  const std::uint64_t strings =
+      sizeof(header) + std::uint64_t{prefix->count} * sizeof(record);
+  if (contents.size() < strings)
+    return invalid_snapshot(path, "truncated records");
+
+  // Validate the records once, so that the accessors need not.
+  const std::uint64_t limit = contents.size() - strings;
+  const auto *records =
+      reinterpret_cast<const record *>(contents.data() + sizeof(header));
+  for (std::uint32_t index = 0; index < prefix->count; ++index) {
+    const record &value = records[index];
+    if (std::uint64_t{value.usr_offset} + value.usr_size > limit ||
+        std::uint64_t{value.name_offset} + value.name_size > limit ||
+        std::uint64_t{value.mangled_name_offset} + value.mangled_name_size >
+            limit)
+      return invalid_snapshot(path, "string out of bounds");
+  }
+
+  return interface_snapshot_file{std::move(*buffer)};
+}
+
+std::size_t interface_snapshot_file::size() const {
+  return reinterpret_cast<const header *>(buffer_->getBufferStart())->count;
+}
+
+llvm::StringRef interface_snapshot_file::usr(std::size_t index) const {
+  const record &value = get_record(*buffer_, index);
+  return get_string(*buffer_, value.usr_offset, value.usr_size);
+}
+
+llvm::StringRef interface_snapshot_file::name(std::size_t index) const {
+  const record &value = get_record(*buffer_, index);
+  return get_string(*buffer_, value.name_offset, value.name_size);
+}
+
+llvm::StringRef interface_snapshot_file::mangled_name(std::size_t index) const {
+  const record &value = get_record(*buffer_, index);
+  return get_string(*buffer_, value.mangled_name_offset,
+                    value.mangled_name_size);
+}
+
+std::uint64_t interface_snapshot_file::signature(std::size_t index) const {
+  return get_record(*buffer_, index).signature;
+}
+
+bool interface_snapshot_file::exported(std::size_t index) const {
+  return get_record(*buffer_, index).flags & kExported;
+}
+
+unsigned diff(const interface_snapshot_file &before,
+              const interface_snapshot_file &after, llvm::raw_ostream &os) {
+  auto describe = [&os](const interface_snapshot_file &snapshot,
+                        std::size_t index) {
+    os << snapshot.name(index);
+    if (!snapshot.mangled_name(index).empty())
+      os << " (" << snapshot.mangled_name(index) << ')';
+    os << '\n';
+  };
+
+  // Both snapshots are ordered by USR, so they are compared in a single pass.
+  unsigned differences = 0;
+  std::size_t lhs = 0, rhs = 0;
+  while (lhs < before.size() || rhs < after.size()) {
+    const int order = lhs == before.size()  ? 1
+                      : rhs == after.size() ? -1
+                      : before.usr(lhs).compare(after.usr(rhs));
+
+    if (order < 0) {
+      os << "removed: ";
+      describe(before, lhs++);
+      ++differences;
+      continue;
+    }
+
+    if (order > 0) {
+      os << (after.exported(rhs) ? "added: " : "added (not exported): ");
+      describe(after, rhs++);
+      ++differences;
+      continue;
+    }
+
+    if (before.signature(lhs) != after.signature(rhs)) {
+      os << "signature changed: ";
+      describe(after, rhs);
+      ++differences;
+    }
+
+    if (before.exported(lhs) != after.exported(rhs)) {
+      os << (after.exported(rhs) ? "now exported: " : "no longer exported: ");
+      describe(after, rhs);
+      ++differences;
+    }
+
+    ++lhs;
+    ++rhs;
+  }
+  return differences;
+}
+}
@@ -0,0 +1,217 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/idt.hh"
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendPluginRegistry.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Tooling/Core/Replacement.h"
+#include "clang/Tooling/ReplacementsYaml.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace idt {
+// Collects the remarks and fix-its produced by the scanner during a compile so
+// that they can be written next to the object file rather than interleaved
+// with the compiler diagnostics. The replacements are serialized in the format
+// consumed by clang-apply-replacements, which merges and deduplicates the
+// results from the individual translation units.
+class findings_collector : public clang::DiagnosticConsumer {
+  std::string findings_;
+  clang::tooling::TranslationUnitReplacements replacements_;
+
+public:
+  explicit findings_collector(llvm::StringRef main_file) {
+    replacements_.MainSourceFile = main_file.str();
+  }
+
+  void HandleDiagnostic(clang::DiagnosticsEngine::Level level,
+                        const clang::Diagnostic &info) override {
+    clang::DiagnosticConsumer::HandleDiagnostic(level, info);
+
+    llvm::SmallString<256> message;
+    info.FormatDiagnostic(message);
+
+    llvm::raw_string_ostream os(findings_);
+    if (info.hasSourceManager() && info.getLocation().isValid()) {
+      const clang::PresumedLoc location =
+          info.getSourceManager().getPresumedLoc(info.getLocation());
+      os << location.getFilename() << ':' << location.getLine() << ':'
+         << location.getColumn() << ": ";
+    }
+    os << "remark: " << message << '\n';
+
+    if (!info.hasSourceManager())
+      return;
+
+    for (const clang::FixItHint &hint : info.getFixItHints())
+      replacements_.Replacements.emplace_back(info.getSourceManager(),
+                                              hint.RemoveRange,
+                                              hint.CodeToInsert);
+  }
+
+  // Write the findings to `<prefix>.idt` and the replacements to
+  // `<prefix>.idt.yaml`. Any output left over from a previous compile is
+  // removed if there is nothing to report.
+  void write(llvm::StringRef prefix, clang::DiagnosticsEngine &diagnostics) {
+    const std::string findings_path = (prefix + ".idt").str();
+    const std::string replacements_path = (prefix + ".idt.yaml").str();
+
+    if (findings_.empty()) {
+      llvm::sys::fs::remove(findings_path);
+      llvm::sys::fs::remove(replacements_path);
+      return;
+    }
+
+    auto report = [&diagnostics](llvm::StringRef path, std::error_code ec) {
+      unsigned id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Error, "unable to write '%0': %1");
+      diagnostics.Report(id) << path << ec.message();
+    };
+
+    std::error_code ec;
+    llvm::raw_fd_ostream findings(findings_path, ec, llvm::sys::fs::OF_Text);
+    if (ec)
+      return report(findings_path, ec);
+    findings << findings_;
+
+    llvm::raw_fd_ostream replacements(replacements_path, ec,
+                                      llvm::sys::fs::OF_Text);
+    if (ec)
+      return report(replacements_path, ec);
+    llvm::yaml::Output yaml(replacements);
+    yaml << replacements_;
+  }
+};
+
+// Runs the scanner over the translation unit after the main action has
+// consumed it, diverting the diagnostics into the findings collector.
+class plugin_consumer : public clang::ASTConsumer {
+  clang::CompilerInstance &instance_;
+  // The plugin action is destroyed once the consumer is created, so the
+  // consumer keeps its own copy of the options.
+  const idt::options options_;
+  PPCallbacks::FileIncludes file_includes_;
+  idt::consumer consumer_;
+
+  // The location of the object file, used as the prefix for the outputs.
+  std::string output_prefix() const {
+    const clang::FrontendOptions &options = instance_.getFrontendOpts();
+    if (!options.OutputFile.empty() && options.OutputFile != "-")
+      return options.OutputFile;
+
+    // Without an object file (e.g. -fsyntax-only), write the outputs into the
+    // working directory, named after the main file.
+    const clang::SourceManager &source_manager = instance_.getSourceManager();
+    if (auto entry = source_manager.getFileEntryRefForID(
+            source_manager.getMainFileID()))
+      return llvm::sys::path::filename(entry->getName()).str();
+    return "a.out";
+  }
+
+public:
+  plugin_consumer(clang::CompilerInstance &instance,
+                  const idt::options &options)
+      : instance_(instance), options_(options),
+        consumer_(options_, file_includes_) {
+    if (idt::requires_includes(options_))
+      instance.getPreprocessor().addPPCallbacks(
+          std::make_unique<PPCallbacks>(instance.getSourceManager(),
+                                        file_includes_));
+  }
+
+  void HandleTranslationUnit(clang::ASTContext &context) override {
+    clang::DiagnosticsEngine &diagnostics = context.getDiagnostics();
+
+    // Do not scan translation units which failed to compile; the AST may be
+    // incomplete and the findings would be misleading.
+    if (diagnostics.hasErrorOccurred())
+      return;
+
+    const clang::SourceManager &source_manager = context.getSourceManager();
+    llvm::StringRef main_file;
+    if (auto entry = source_manager.getFileEntryRefForID(
+            source_manager.getMainFileID()))
+      main_file = entry->getName();
+
+    findings_collector collector{main_file};
+
+    clang::DiagnosticConsumer *client = diagnostics.getClient();
+    const bool owns_client = diagnostics.ownsClient();
+    std::unique_ptr<clang::DiagnosticConsumer> owner = diagnostics.takeClient();
+    diagnostics.setClient(&collector, /*ShouldOwnClient=*/false);
+
+    consumer_.HandleTranslationUnit(context);
+
+    diagnostics.setClient(owns_client ? owner.release() : client, owns_client);
+
+    collector.write(output_prefix(), diagnostics);
+  }
+};
+
+// The plugin is registered as `idt` and is configured through plugin
+// arguments, e.g.
+//
+//   clang++ -fplugin=libidt.so -fplugin-arg-idt-export-macro=PROJECT_ABI ...
+//
+// It runs after the main action, so the scan reuses the AST which the compile
+// has already built.
+class plugin_action : public clang::PluginASTAction {
+  idt::options options_;
+
+protected:
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI, llvm::StringRef) override {
+    return std::make_unique<plugin_consumer>(CI, options_);
+  }
+
+  bool ParseArgs(const clang::CompilerInstance &CI,
+                 const std::vector<std::string> &arguments) override {
+    clang::DiagnosticsEngine &diagnostics = CI.getDiagnostics();
+
+    for (const auto &argument : arguments) {
+      auto [key, value] = llvm::StringRef(argument).split('=');
+      if (key == "export-macro") {
+        options_.export_macro = value.str();
+      } else if (key == "include-header") {
+        options_.include_header = value.str();
+      } else if (key == "ignore") {
+        llvm::SmallVector<llvm::StringRef, 4> symbols;
+        value.split(symbols, ',', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+        for (const auto &symbol : symbols)
+          options_.ignored_symbols.insert(symbol.str());
+      } else {
+        unsigned id = diagnostics.getCustomDiagID(
+            clang::DiagnosticsEngine::Error, "idt: unknown argument '%0'");
+        diagnostics.Report(id) << argument;
+        return false;
+      }
+    }
+
+    if (options_.export_macro.empty()) {
+      unsigned id = diagnostics.getCustomDiagID(
+          clang::DiagnosticsEngine::Error,
+          "idt: missing required argument 'export-macro'");
+      diagnostics.Report(id);
+      return false;
+    }
+
+    return true;
+  }
+
+  ActionType getActionType() override {
+    return AddAfterMainAction;
+  }
+};
+}
+
+static clang::FrontendPluginRegistry::Add<idt::plugin_action>
+    X("idt", "interface definition scanner");
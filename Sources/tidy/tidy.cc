@@ -0,0 +1,117 @@
+// Copyright (c) 2021 Saleem Abdulrasool.  All Rights Reserved.
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "idt/idt.hh"
+
+#include "clang-tidy/ClangTidyCheck.h"
+#include "clang-tidy/ClangTidyModule.h"
+#include "clang-tidy/ClangTidyModuleRegistry.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <memory>
+#include <string>
+
+namespace idt {
+// Reports the declarations which the idt tool would annotate, with equivalent
+// fix-its. The check is configured through the check options:
+//
+//   CheckOptions:
+//     idt-unexported-public-interface.ExportMacro: PROJECT_ABI
+//     idt-unexported-public-interface.IncludeHeader: project/Export.h
+//     idt-unexported-public-interface.IgnoredSymbols: f,g
+class unexported_public_interface_check : public clang::tidy::ClangTidyCheck {
+  idt::options options_;
+  PPCallbacks::FileIncludes file_includes_;
+
+public:
+  unexported_public_interface_check(llvm::StringRef name,
+                                    clang::tidy::ClangTidyContext *context)
+      : clang::tidy::ClangTidyCheck(name, context) {
+    options_.export_macro = Options.get("ExportMacro", "").str();
+    options_.include_header = Options.get("IncludeHeader", "").str();
+
+    llvm::SmallVector<llvm::StringRef, 4> symbols;
+    Options.get("IgnoredSymbols", "")
+        .split(symbols, ',', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+    for (const auto &symbol : symbols)
+      options_.ignored_symbols.insert(symbol.trim().str());
+  }
+
+  void storeOptions(clang::tidy::ClangTidyOptions::OptionMap &map) override {
+    Options.store(map, "ExportMacro", options_.export_macro);
+    Options.store(map, "IncludeHeader", options_.include_header);
+
+    std::string symbols;
+    for (const auto &symbol : options_.ignored_symbols)
+      symbols += (symbols.empty() ? "" : ",") + symbol;
+    Options.store(map, "IgnoredSymbols", symbols);
+  }
+
+  bool isLanguageVersionSupported(
+      const clang::LangOptions &language_options) const override {
+    return language_options.CPlusPlus;
+  }
+
+  void registerPPCallbacks(const clang::SourceManager &source_manager,
+                           clang::Preprocessor *preprocessor,
+                           clang::Preprocessor *) override {
+    if (idt::requires_includes(options_))
+      preprocessor->addPPCallbacks(
+          std::make_unique<PPCallbacks>(source_manager, file_includes_));
+  }
+
+  void registerMatchers(clang::ast_matchers::MatchFinder *finder) override {
+    if (options_.export_macro.empty()) {
+      configurationDiag("idt-unexported-public-interface: the 'ExportMacro' "
+                        "option is required");
+      return;
+    }
+
+    // The analysis traverses the whole translation unit at once, as whether a
+    // member requires annotation depends on whether its record is exported.
+    finder->addMatcher(
+        clang::ast_matchers::translationUnitDecl().bind("translation-unit"),
+        this);
+  }
+
+  void check(
+      const clang::ast_matchers::MatchFinder::MatchResult &result) override {
+    for (const finding &entry :
+         idt::analyze(*result.Context, options_, file_includes_)) {
+      switch (entry.kind) {
+      case finding_kind::missing_include:
+        diag(entry.location, "missing include statement %0")
+            << entry.argument << entry.fixit;
+        break;
+      case finding_kind::unexported_public_interface:
+        diag(entry.location, "unexported public interface %0")
+            << entry.decl << entry.fixit;
+        break;
+      case finding_kind::exported_private_interface:
+        diag(entry.location, "exported private interface %0 (%1)")
+            << entry.decl << entry.argument << entry.fixit;
+        break;
+      case finding_kind::exported_interface:
+      case finding_kind::template_instantiation:
+      case finding_kind::explanation:
+      case finding_kind::untargeted_interface:
+        break;
+      }
+    }
+  }
+};
+
+class tidy_module : public clang::tidy::ClangTidyModule {
+public:
+  void addCheckFactories(
+      clang::tidy::ClangTidyCheckFactories &factories) override {
+    factories.registerCheck<unexported_public_interface_check>(
+        "idt-unexported-public-interface");
+  }
+};
+}
+
+static clang::tidy::ClangTidyModuleRegistry::Add<idt::tidy_module>
+    X("idt-module", "Adds the interface definition scanner checks.");
@@ -0,0 +1,43 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: not %idt -export-macro IDT_TEST_ABI -export-index %t/timeout -tu-timeout 1 %s %S/DefinitionsInSource.cc -- -I%S/include -fconstexpr-steps=100000000 2>&1 | %FileCheck %s --check-prefix=CHECK-TIMEOUT
+// RUN: %FileCheck %s --check-prefix=CHECK-INDEX < %t/timeout
+// RUN: not %idt -export-macro IDT_TEST_ABI -export-index %t/failed %s -- -I%S/include -DIDT_FAILED 2>&1 | %FileCheck %s --check-prefix=CHECK-FAILED
+// RUN: %idt -export-macro IDT_TEST_ABI -export-index %t/failed %S/DefinitionsInSource.cc -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: %FileCheck %s --check-prefix=CHECK-INDEX < %t/failed
+
+// The declarations decided by a source which could not be analyzed are not
+// recorded in the index, so another source which includes the same header
+// still reports them, in the same run or a later one.
+#include "Widget.h"
+
+#if defined(IDT_FAILED)
+#error this source does not compile
+#else
+constexpr unsigned long long spin(unsigned long long seed) {
+  for (unsigned long long i = 0; i < (1ull << 22); ++i)
+    seed += i;
+  return seed;
+}
+
+static_assert(spin(1) != 0);
+static_assert(spin(2) != 0);
+static_assert(spin(3) != 0);
+static_assert(spin(4) != 0);
+static_assert(spin(5) != 0);
+static_assert(spin(6) != 0);
+static_assert(spin(7) != 0);
+static_assert(spin(8) != 0);
+#endif
+
+// CHECK-TIMEOUT: Widget.h:1:8: remark: unexported public interface 'Widget'
+// CHECK-TIMEOUT: sources which could not be analyzed: 1
+// CHECK-TIMEOUT-NEXT: AbandonedSources.cc: timed out after 1s
+
+// CHECK-FAILED: sources which could not be analyzed: 1
+// CHECK-FAILED-NEXT: AbandonedSources.cc: failed
+
+// CHECK: Widget.h:1:8: remark: unexported public interface 'Widget'
+// CHECK: Widget.h:7:1: remark: unexported public interface 'make_widget'
+
+// CHECK-INDEX: reported c:@S@Widget
@@ -0,0 +1,33 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t
+// RUN: echo '[{"directory": "%/S", "file": "%/S/include/GadgetClient.cpp", "arguments": ["clang++", "-fsyntax-only", "-I%/S", "%/S/include/GadgetClient.cpp"]}]' > %t/compile_commands.json
+// RUN: %idt -export-macro IDT_TEST_ABI -from-clients %t %s 2>&1 | %FileCheck %s
+
+// Only the declarations which the client references are annotated, including
+// those which it reaches through the inline functions which it calls.
+namespace ns {
+// CHECK: ClientUsage.hh:[[@LINE+1]]:1: remark: unexported public interface 'used'
+int used(int);
+
+// CHECK-NOT: remark: unexported public interface 'unused'
+void unused();
+
+// CHECK: ClientUsage.hh:[[@LINE+1]]:1: remark: unexported public interface 'helper'
+int helper();
+
+inline int wrapper() { return helper(); }
+
+class Gadget {
+public:
+  // CHECK: ClientUsage.hh:[[@LINE+1]]:3: remark: unexported public interface 'Gadget'
+  Gadget();
+
+  // CHECK: ClientUsage.hh:[[@LINE+1]]:3: remark: unexported public interface 'size'
+  int size() const;
+
+  // CHECK-NOT: remark: unexported public interface 'reset'
+  void reset();
+};
+}
+
+// CHECK: annotated 4 of 6 declarations requiring export; leaving the 2 untargeted declarations unexported omits approximately 2 symbols from the dynamic symbol table
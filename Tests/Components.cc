@@ -0,0 +1,27 @@
+// RUN: %idt -component '*/alpha/*=ALPHA_ABI,alpha/Export.h' -component %S/include/beta/=BETA_ABI %s -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -component '*/alpha/*=ALPHA_ABI' %s -- -I%S/include 2>&1 | %FileCheck %s --check-prefix=CHECK-DEFAULT
+// RUN: not %idt -component '*/alpha/*' %s -- -I%S/include 2>&1 | %FileCheck %s --check-prefix=CHECK-INVALID
+
+#include "alpha/Alpha.h"
+#include "beta/Beta.h"
+
+// Each header is annotated with the macro of its component, and the headers
+// which belong to no component are not annotated without an export macro.
+
+// CHECK-NOT: globalFunction
+// CHECK: Alpha.h:1:1: remark: missing include statement alpha/Export.h
+// CHECK: Alpha.h:3:1: remark: unexported public interface 'alpha_function'
+// CHECK: ALPHA_ABI
+// CHECK-NOT: missing include statement
+// CHECK: Beta.h:3:1: remark: unexported public interface 'beta_function'
+// CHECK: BETA_ABI
+// CHECK-NOT: globalFunction
+
+// CHECK-DEFAULT: GlobalHeader.h:1:1: remark: unexported public interface 'globalFunction'
+// CHECK-DEFAULT: IDT_TEST_ABI
+// CHECK-DEFAULT: Alpha.h:3:1: remark: unexported public interface 'alpha_function'
+// CHECK-DEFAULT: ALPHA_ABI
+// CHECK-DEFAULT: Beta.h:3:1: remark: unexported public interface 'beta_function'
+// CHECK-DEFAULT: IDT_TEST_ABI
+
+// CHECK-INVALID: invalid --component '*/alpha/*=': expected <pattern>=<define>[,<header>]
@@ -0,0 +1,31 @@
+// RUN: %idt -export-macro IDT_TEST_ABI -configuration=-DIDT_CONFIGURATION_A -configuration=-DIDT_CONFIGURATION_B %s -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: cp %S/include/Configurations.h %S/include/GlobalHeader.h %t
+// RUN: %idt -export-macro IDT_TEST_ABI -configuration=-DIDT_CONFIGURATION_A -configuration=-DIDT_CONFIGURATION_B -apply-fixits -inplace %s -- -I%t
+// RUN: %FileCheck %s --check-prefix=CHECK-APPLIED < %t/Configurations.h
+
+#include "Configurations.h"
+
+// CHECK: configuration 1: -DIDT_CONFIGURATION_A
+// CHECK: Configurations.h:4:1: remark: unexported public interface 'configuration_a_function'
+// CHECK: configuration 2: -DIDT_CONFIGURATION_B
+// CHECK: Configurations.h:6:1: remark: unexported public interface 'configuration_b_function'
+
+// The declarations common to both configurations are only changed once.
+
+// CHECK: configuration-dependent exports:
+// CHECK-NEXT:   configuration_a_function: not exported in '-DIDT_CONFIGURATION_B'
+// CHECK-NEXT:   configuration_b_function: not exported in '-DIDT_CONFIGURATION_A'
+// CHECK-NEXT: fix-it:"{{.*}}Configurations.h":{4:1-4:1}:"IDT_TEST_ABI "
+// CHECK-NEXT: fix-it:"{{.*}}Configurations.h":{6:1-6:1}:"IDT_TEST_ABI "
+// CHECK-NEXT: fix-it:"{{.*}}Configurations.h":{9:1-9:1}:"IDT_TEST_ABI "
+// CHECK-NEXT: fix-it:"{{.*}}GlobalHeader.h":{1:1-1:1}:"IDT_TEST_ABI "
+
+// CHECK-APPLIED: #if defined(IDT_CONFIGURATION_A)
+// CHECK-APPLIED-NEXT: IDT_TEST_ABI void configuration_a_function();
+// CHECK-APPLIED-NEXT: #else
+// CHECK-APPLIED-NEXT: IDT_TEST_ABI void configuration_b_function();
+// CHECK-APPLIED-NEXT: #endif
+// CHECK-APPLIED-EMPTY:
+// CHECK-APPLIED-NEXT: IDT_TEST_ABI void common_function();
@@ -0,0 +1,18 @@
+// RUN: %idt -export-macro IDT_TEST_ABI %s -- -I%S/include 2>&1 | %FileCheck %s
+
+#include "Sprocket.h"
+#include "Widget.h"
+
+// The definitions in the source of the virtual methods are not visible to the
+// clients of the header, so the class is exported as when analyzing any other
+// source. The definitions in the header remain visible.
+
+Widget::~Widget() {}
+void Widget::draw() {}
+void Widget::resize(int) {}
+
+// CHECK-NOT: remark: unexported public interface '{{Sprocket|~Sprocket|turn|make_sprocket}}'
+// CHECK: Widget.h:1:8: remark: unexported public interface 'Widget'
+// CHECK-NOT: remark: unexported public interface '{{~Widget|draw|resize}}'
+// CHECK: Widget.h:7:1: remark: unexported public interface 'make_widget'
+// CHECK-NOT: remark: unexported public interface
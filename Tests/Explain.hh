@@ -0,0 +1,19 @@
+// RUN: %idt -export-macro IDT_TEST_ABI -explain=widget::draw -stats %s 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -explain=widget::size %s 2>&1 | %FileCheck %s --check-prefix=CHECK-DEFINED
+
+namespace widget {
+void draw();
+// CHECK: Explain.hh:[[@LINE-1]]:6: remark: explain 'widget::draw': already exported: no
+// CHECK: Explain.hh:[[@LINE-2]]:6: remark: explain 'widget::draw': in a system header: no
+// CHECK: Explain.hh:[[@LINE-3]]:6: remark: explain 'widget::draw': in no component: no
+// CHECK: Explain.hh:[[@LINE-4]]:6: remark: explain 'widget::draw': annotated with IDT_TEST_ABI
+
+inline int size() { return 0; }
+// CHECK-DEFINED: Explain.hh:[[@LINE-1]]:12: remark: explain 'widget::size': has a definition visible to clients: yes, rejected
+// CHECK-DEFINED-NOT: remark: explain 'widget::size': ignored
+}
+
+// CHECK-NOT: remark: explain 'widget::size'
+// CHECK: statistics:
+// CHECK: predicates (evaluated, rejected, time):
+// CHECK: {{[0-9]+ +[0-9]+ +[0-9.]+ ms}} has a definition visible to clients
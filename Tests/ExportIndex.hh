@@ -0,0 +1,26 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: %idt -export-macro IDT_TEST_ABI -export-index %t/index %s 2>&1 | %FileCheck %s --check-prefix=CHECK-FIRST
+// RUN: %FileCheck %s --check-prefix=CHECK-INDEX < %t/index
+// RUN: %idt -export-macro IDT_TEST_ABI -export-index %t/index %s 2>&1 | %FileCheck %s --check-prefix=CHECK-SECOND --allow-empty
+// RUN: cp %s %t/ExportIndex.hh
+// RUN: %idt -export-macro IDT_TEST_ABI -export-index %t/index -apply-fixits -inplace %t/ExportIndex.hh
+// RUN: %FileCheck %s --check-prefix=CHECK-APPLIED < %t/ExportIndex.hh
+// RUN: %FileCheck %s --check-prefix=CHECK-APPLIED-INDEX < %t/index
+
+void function();
+// CHECK-FIRST: ExportIndex.hh:[[@LINE-1]]:1: remark: unexported public interface 'function'
+// CHECK-INDEX: reported c:@F@function
+// CHECK-APPLIED: {{^}}IDT_TEST_ABI void function();
+// CHECK-APPLIED-INDEX: applied c:@F@function
+
+class Record {
+public:
+  void method();
+  // CHECK-FIRST: ExportIndex.hh:[[@LINE-1]]:3: remark: unexported public interface 'method'
+  // CHECK-INDEX: reported c:@S@Record@F@method
+  // CHECK-APPLIED: {{^}}  IDT_TEST_ABI void method();
+  // CHECK-APPLIED-INDEX: applied c:@S@Record@F@method
+};
+
+// CHECK-SECOND-NOT: remark: unexported public interface
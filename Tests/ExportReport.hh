@@ -0,0 +1,32 @@
+// RUN: %idt -export-macro IDT_TEST_ABI -export-report -export-budget 8 %s 2>&1 | %FileCheck %s
+
+#define IDT_TEST_ABI __attribute__((visibility("default")))
+
+IDT_TEST_ABI void annotated_function();
+
+void unannotated_function();
+
+namespace ns {
+class IDT_TEST_ABI Exported {
+public:
+  Exported();
+  Exported(const Exported &);
+  Exported &operator=(const Exported &);
+  ~Exported();
+
+  void method();
+  void inline_method() {}
+};
+}
+
+// CHECK: estimated exported symbols: 8 (7 annotated, 1 proposed)
+// CHECK-NEXT: exported symbols by header:
+// CHECK-NEXT:   8 {{.*}}ExportReport.hh
+// CHECK-NEXT: exported symbols by namespace:
+// CHECK-NEXT:   6 ns
+// CHECK-NEXT:   2 (global namespace)
+// CHECK-NEXT: exported symbols by class:
+// CHECK-NEXT:   6 ns::Exported
+// CHECK-NEXT: most costly class-level exports:
+// CHECK-NEXT:   6 ns::Exported (5 with member-level export)
+// CHECK-NEXT: warning: the estimated number of exported symbols (8) is within 10% of the budget of 8
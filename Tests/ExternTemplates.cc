@@ -0,0 +1,24 @@
+// RUN: %idt -export-macro IDT_TEST_ABI -extern-templates -extern-template-macro IDT_TEMPLATE_ABI %s %S/include/BoxClient.cpp -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -extern-templates -extern-template-threshold 1 %s -- -I%S/include 2>&1 | %FileCheck %s --check-prefix=CHECK-THRESHOLD
+
+#include "Box.h"
+
+namespace {
+struct Local {};
+}
+
+int use() {
+  ns::Box<int> box{1};
+  ns::Box<Local> local{};
+  return box.get();
+}
+
+// CHECK: extern template candidates:
+// CHECK-NEXT:   ns::Box<int>: instantiated in 2 translation units
+// CHECK-NEXT:     header {{.*}}Box.h: extern template struct IDT_TEMPLATE_ABI ns::Box<int>;
+// CHECK-NEXT:     source: template struct IDT_TEMPLATE_ABI ns::Box<int>;
+// CHECK-NOT: Local
+
+// CHECK-THRESHOLD: extern template candidates:
+// CHECK-THRESHOLD-NEXT:   ns::Box<int>: instantiated in 1 translation units
+// CHECK-THRESHOLD-NEXT:     header {{.*}}Box.h: extern template struct ns::Box<int>;
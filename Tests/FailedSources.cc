@@ -0,0 +1,12 @@
+// RUN: not %idt -export-macro IDT_TEST_ABI %s %S/DefinitionsInSource.cc -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: not %idt -export-macro IDT_TEST_ABI -tu-timeout 600 %s %S/DefinitionsInSource.cc -- -I%S/include 2>&1 | %FileCheck %s
+
+// A source which fails to compile does not end the run; the sources after it
+// are still analyzed, and it is reported once the run completes.
+#error this source does not compile
+// CHECK: FailedSources.cc:[[@LINE-1]]:2: error: this source does not compile
+
+// CHECK: Widget.h:1:8: remark: unexported public interface 'Widget'
+// CHECK: Widget.h:7:1: remark: unexported public interface 'make_widget'
+// CHECK: sources which could not be analyzed: 1
+// CHECK-NEXT: FailedSources.cc: failed
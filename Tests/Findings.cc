@@ -0,0 +1,17 @@
+// RUN: rm -rf %t
+// RUN: %idt -export-macro IDT_TEST_ABI -findings %t -stats %S/DefinitionsInSource.cc %s -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: %FileCheck %s --check-prefix=CHECK-FINDINGS --input-file %t
+
+#include "Widget.h"
+#include "GlobalHeader.h"
+
+// Widget.h is reached by both sources, and its findings are only recorded
+// once. They are written in order of their location rather than in the order
+// in which the sources were analyzed.
+
+// CHECK: findings recorded: 3 ({{[0-9]+}} KiB)
+
+// CHECK-FINDINGS: {{.*}}GlobalHeader.h:1:1: unexported public interface 'globalFunction' (1 symbol)
+// CHECK-FINDINGS-NEXT: {{.*}}Widget.h:1:8: unexported public interface 'Widget' ({{[0-9]+}} symbols)
+// CHECK-FINDINGS-NEXT: {{.*}}Widget.h:7:1: unexported public interface 'make_widget' (1 symbol)
+// CHECK-FINDINGS-NOT: {{.}}
@@ -0,0 +1,15 @@
+// RUN: %idt -export-macro IDT_TEST_ABI -header-filter 'GlobalHeader\.h$' -stats %s -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -header-filter 'Box\.h$' -stats %s -- -I%S/include 2>&1 | %FileCheck %s --check-prefix=CHECK-FILTERED
+// RUN: %idt -export-macro IDT_TEST_ABI -header-extensions inc -stats %s -- -I%S/include 2>&1 | %FileCheck %s --check-prefix=CHECK-FILTERED
+
+#include "GlobalHeader.h"
+
+// CHECK: GlobalHeader.h:{{[0-9]+}}:{{[0-9]+}}: remark: unexported public interface
+// CHECK: statistics:
+// CHECK-NEXT:   translation units: 1
+// CHECK-NEXT:   file classifications: {{[0-9]+}} ({{[0-9]+}} cached)
+// CHECK-NEXT:   enclosing class export status: {{[0-9]+}} ({{[0-9]+}} cached)
+// CHECK-NEXT:   headers excluded by the header filter: 0
+
+// CHECK-FILTERED-NOT: remark: unexported public interface
+// CHECK-FILTERED: statistics:
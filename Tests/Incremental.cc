@@ -0,0 +1,26 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t/src
+// RUN: cp %s %S/include/Widget.h %t/src
+// RUN: %idt -export-macro IDT_TEST_ABI -incremental %t/record %t/src/Incremental.cc -- 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -incremental %t/record %t/src/Incremental.cc -- 2>&1 | %FileCheck %s --check-prefix=CHECK-SKIPPED
+// RUN: %idt -export-macro IDT_TEST_ABI -incremental %t/record %t/src/Incremental.cc -- -DIDT_INCREMENTAL 2>&1 | %FileCheck %s
+// RUN: echo "void make_gadget();" >> %t/src/Widget.h
+// RUN: %idt -export-macro IDT_TEST_ABI -incremental %t/record %t/src/Incremental.cc -- -DIDT_INCREMENTAL 2>&1 | %FileCheck %s --check-prefix=CHECK-CHANGED
+// RUN: not %idt -export-macro IDT_TEST_ABI -incremental %t/record -snapshot %t/snapshot %t/src/Incremental.cc -- 2>&1 | %FileCheck %s --check-prefix=CHECK-REJECTED
+
+// The second run skips the source, as neither it nor the header it includes
+// has changed; a different compile command, or a change to the header, causes
+// it to be analyzed again.
+#include "Widget.h"
+
+// CHECK-NOT: skipped
+// CHECK: Widget.h:1:8: remark: unexported public interface 'Widget'
+// CHECK: Widget.h:7:1: remark: unexported public interface 'make_widget'
+
+// CHECK-SKIPPED: skipped 1 unchanged sources
+// CHECK-SKIPPED-NOT: remark:
+
+// CHECK-CHANGED-NOT: skipped
+// CHECK-CHANGED: remark: unexported public interface 'make_gadget'
+
+// CHECK-REJECTED: --incremental cannot be used with --export-report, --findings, --over-exports, --snapshot or --symbol-file
@@ -0,0 +1,27 @@
+// RUN: %idt -export-macro IDT_TEST_ABI -from-link-log %S/Inputs/LinkErrors.log %s 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -from-link-log %S/Inputs/NoLinkErrors.log %s 2>&1 | %FileCheck %s --check-prefix=CHECK-EMPTY
+
+namespace ns {
+// CHECK-NOT: remark: unexported public interface 'resolved'
+void resolved();
+
+// CHECK: LinkLog.hh:[[@LINE+1]]:1: remark: unexported public interface 'unresolved'
+void unresolved();
+
+// CHECK: LinkLog.hh:[[@LINE+1]]:1: remark: unexported public interface 'mangled'
+int mangled(int);
+
+// CHECK: LinkLog.hh:[[@LINE+1]]:8: remark: unexported public interface 'counter'
+extern int counter;
+
+class Widget {
+public:
+  // CHECK: LinkLog.hh:[[@LINE+1]]:3: remark: unexported public interface 'Widget'
+  Widget();
+
+  // CHECK-NOT: remark: unexported public interface 'draw'
+  void draw();
+};
+}
+
+// CHECK-EMPTY: no undefined symbols found in '{{.*}}NoLinkErrors.log'
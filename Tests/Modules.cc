@@ -0,0 +1,10 @@
+// RUN: rm -rf %t
+// RUN: %idt -export-macro IDT_TEST_ABI -module-cache-path %t %s -- -I%S/include/modules 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -module-cache-path %t %s -- -I%S/include/modules 2>&1 | %FileCheck %s
+
+// The header is imported as a module, which the second run loads from the
+// cache, and its declarations are still analyzed.
+#include "Gear.h"
+
+// CHECK: Gear.h:2:3: remark: unexported public interface 'turn'
+// CHECK: Gear.h:5:1: remark: unexported public interface 'gear_count'
@@ -0,0 +1,32 @@
+// RUN: %idt -export-macro IDT_TEST_ABI -over-exports %s 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -over-exports -private-header 'OverExports\.hh$' %s 2>&1 | %FileCheck %s --check-prefix=CHECK-PRIVATE
+// RUN: %idt -export-macro IDT_TEST_ABI -over-exports -header-filter 'NoSuchHeader\.h$' %s 2>&1 | %FileCheck %s
+
+#define IDT_TEST_ABI __attribute__((visibility("default")))
+
+IDT_TEST_ABI void public_function();
+// CHECK-NOT: exported private interface 'public_function'
+// CHECK-PRIVATE: OverExports.hh:[[@LINE-2]]:1: remark: exported private interface 'public_function' (declared outside of the public headers)
+
+IDT_TEST_ABI inline void inline_function() {}
+// CHECK: OverExports.hh:[[@LINE-1]]:1: remark: exported private interface 'inline_function' (inline function)
+
+namespace detail {
+IDT_TEST_ABI void internal_function();
+// CHECK: OverExports.hh:[[@LINE-1]]:1: remark: exported private interface 'internal_function' (declared in an internal namespace)
+}
+
+class Class {
+public:
+  IDT_TEST_ABI void method();
+  void inline_method() { referenced(); }
+
+private:
+  IDT_TEST_ABI void referenced();
+  IDT_TEST_ABI void unreferenced();
+// CHECK-NOT: exported private interface 'referenced'
+// CHECK: OverExports.hh:[[@LINE-2]]:3: remark: exported private interface 'unreferenced' (private member not referenced from inline code)
+};
+// CHECK-NOT: exported private interface 'method'
+
+// CHECK: 3 exported private interfaces; removing the annotations would remove approximately 3 symbols from the dynamic symbol table
@@ -0,0 +1,16 @@
+// REQUIRES: plugin
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: %clang -x c++ -std=c++17 -c %s -o %t/Plugin.o -fplugin=%idt_plugin -fplugin-arg-idt-export-macro=IDT_TEST_ABI -fplugin-arg-idt-ignore=ignored_function
+// RUN: %FileCheck %s < %t/Plugin.o.idt
+// RUN: %FileCheck %s --check-prefix=CHECK-YAML < %t/Plugin.o.idt.yaml
+
+// CHECK: Plugin.hh:[[@LINE+3]]:1: remark: unexported public interface 'function'
+// CHECK-YAML: ReplacementText: 'IDT_TEST_ABI '
+// CHECK-YAML-NOT: ReplacementText
+void function();
+
+// CHECK-NOT: remark: unexported public interface 'ignored_function'
+void ignored_function();
+
+inline void inline_function() {}
@@ -0,0 +1,23 @@
+// REQUIRES: plugin
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: %clang -x c++ -std=c++17 -c %s -o %t/PluginOptions.o -fplugin=%idt_plugin -fplugin-arg-idt-export-macro=IDT_TEST_ABI -fplugin-arg-idt-include-header=project/ExportDefs.h -fplugin-arg-idt-ignore=first_ignored_function,second_ignored_function
+// RUN: %FileCheck %s < %t/PluginOptions.o.idt
+
+// The plugin action is destroyed before the translation unit is scanned, so
+// the scan must use the options which the consumer keeps rather than those of
+// the action.
+
+#pragma once
+
+#include "PluginOptions.hh"
+// CHECK: PluginOptions.hh:[[@LINE-1]]:1: remark: missing include statement project/ExportDefs.h
+
+// CHECK-NOT: remark: unexported public interface 'first_ignored_function'
+void first_ignored_function();
+
+// CHECK-NOT: remark: unexported public interface 'second_ignored_function'
+void second_ignored_function();
+
+// CHECK: PluginOptions.hh:[[@LINE+1]]:1: remark: unexported public interface 'function'
+void function();
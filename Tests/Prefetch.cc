@@ -0,0 +1,14 @@
+// RUN: %idt -export-macro IDT_TEST_ABI -prefetch %s %S/DefinitionsInSource.cc -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: %idt -export-macro IDT_TEST_ABI -prefetch -configuration=-DIDT_PREFETCH_A -configuration=-DIDT_PREFETCH_B %s %S/DefinitionsInSource.cc -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: not %idt -export-macro IDT_TEST_ABI -prefetch -apply-fixits %s -- 2>&1 | %FileCheck %s --check-prefix=CHECK-APPLY
+
+// The files of the second source are read while the first is analyzed, which
+// does not change the findings of either.
+#include "GlobalHeader.h"
+
+// CHECK: GlobalHeader.h:1:1: remark: unexported public interface 'globalFunction'
+// CHECK: Widget.h:1:8: remark: unexported public interface 'Widget'
+// CHECK: Widget.h:7:1: remark: unexported public interface 'make_widget'
+// CHECK-NOT: sources which could not be analyzed
+
+// CHECK-APPLY: --prefetch cannot be used with --apply-fixits
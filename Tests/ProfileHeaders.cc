@@ -0,0 +1,11 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: %idt -export-macro IDT_TEST_ABI -profile-headers -profile-trace %t/trace.json %s -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: %FileCheck %s --check-prefix=CHECK-TRACE < %t/trace.json
+
+#include <GlobalHeader.h>
+
+// CHECK: header times (inclusive, exclusive, inclusions):
+// CHECK-NEXT: {{ +[0-9]+\.[0-9]+ ms +[0-9]+\.[0-9]+ ms +1 .*}}GlobalHeader.h
+
+// CHECK-TRACE: "traceEvents"
@@ -0,0 +1,23 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t/src
+// RUN: cp %s %S/include/Widget.h %t/src
+// RUN: %idt -export-macro IDT_TEST_ABI -capture %t/reproducer %t/src/Reproducer.cc -- -DIDT_REPRODUCER 2>&1 | %FileCheck %s --check-prefix=CHECK-CAPTURE
+// RUN: rm -rf %t/src
+// RUN: %idt -replay %t/reproducer -stats 2>&1 | %FileCheck %s --check-prefix=CHECK-REPLAY
+
+#include "Widget.h"
+
+// The source and the header are removed before the replay, which reads them,
+// and the compile command, from the reproducer.
+#if !defined(IDT_REPRODUCER)
+#error the compile command was not recorded
+#endif
+
+// CHECK-CAPTURE: Widget.h:1:8: remark: unexported public interface 'Widget'
+// CHECK-CAPTURE: captured {{[0-9]+}} files in '{{.*}}reproducer'
+
+// CHECK-REPLAY-NOT: error:
+// CHECK-REPLAY: Widget.h:1:8: remark: unexported public interface 'Widget'
+// CHECK-REPLAY: Widget.h:7:1: remark: unexported public interface 'make_widget'
+// CHECK-REPLAY: statistics:
+// CHECK-REPLAY-NEXT: translation units: 1
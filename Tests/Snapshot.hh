@@ -0,0 +1,28 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: %idt -export-macro IDT_TEST_ABI -snapshot %t/before.idts %s -- --target=x86_64-unknown-linux-gnu -x c++-header
+// RUN: %idt -export-macro IDT_TEST_ABI -snapshot %t/after.idts %s -- --target=x86_64-unknown-linux-gnu -x c++-header -DAFTER
+// RUN: %idt -diff-snapshot %t/before.idts %t/before.idts | %FileCheck %s --check-prefix=CHECK-IDENTICAL --allow-empty
+// RUN: not %idt -diff-snapshot %t/before.idts %t/after.idts | %FileCheck %s
+
+#define IDT_TEST_ABI __attribute__((visibility("default")))
+
+IDT_TEST_ABI void stable();
+
+#if defined(AFTER)
+IDT_TEST_ABI long changed();
+void added();
+IDT_TEST_ABI void now_exported();
+#else
+IDT_TEST_ABI int changed();
+void now_exported();
+IDT_TEST_ABI void removed();
+#endif
+
+// CHECK-IDENTICAL-NOT: {{.}}
+
+// CHECK: added (not exported): added (_Z5addedv)
+// CHECK-NEXT: signature changed: changed (_Z7changedv)
+// CHECK-NEXT: now exported: now_exported (_Z12now_exportedv)
+// CHECK-NEXT: removed: removed (_Z7removedv)
+// CHECK-NOT: stable
@@ -0,0 +1,49 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: %idt -export-macro IDT_TEST_ABI -symbol-file %t/exports.map %s -- --target=x86_64-unknown-linux-gnu -x c++-header
+// RUN: %FileCheck %s --check-prefix=CHECK-ELF < %t/exports.map
+// RUN: %idt -export-macro IDT_TEST_ABI -symbol-file %t/exports.exp %s -- --target=arm64-apple-macos -x c++-header
+// RUN: %FileCheck %s --check-prefix=CHECK-MACHO < %t/exports.exp
+// RUN: %idt -export-macro IDT_TEST_ABI -symbol-file %t/exports.def %s -- --target=x86_64-unknown-windows-msvc -x c++-header
+// RUN: %FileCheck %s --check-prefix=CHECK-DEF < %t/exports.def
+
+namespace ns {
+void function();
+
+extern int variable;
+
+__attribute__((visibility("default"))) void annotated();
+
+class Polymorphic {
+public:
+  virtual ~Polymorphic();
+  virtual void method();
+  void inline_method() {}
+};
+}
+
+// CHECK-ELF: {
+// CHECK-ELF-NEXT:   global:
+// CHECK-ELF-NEXT:     _ZN2ns11Polymorphic6methodEv;
+// CHECK-ELF-NEXT:     _ZN2ns11PolymorphicD0Ev;
+// CHECK-ELF-NEXT:     _ZN2ns11PolymorphicD1Ev;
+// CHECK-ELF-NEXT:     _ZN2ns11PolymorphicD2Ev;
+// CHECK-ELF-NEXT:     _ZN2ns8functionEv;
+// CHECK-ELF-NEXT:     _ZN2ns8variableE;
+// CHECK-ELF-NEXT:     _ZN2ns9annotatedEv;
+// CHECK-ELF-NEXT:     _ZTIN2ns11PolymorphicE;
+// CHECK-ELF-NEXT:     _ZTSN2ns11PolymorphicE;
+// CHECK-ELF-NEXT:     _ZTVN2ns11PolymorphicE;
+// CHECK-ELF-NEXT:   local:
+// CHECK-ELF-NEXT:     *;
+// CHECK-ELF-NEXT: };
+
+// CHECK-MACHO-DAG: __ZN2ns8functionEv
+// CHECK-MACHO-DAG: __ZN2ns8variableE
+// CHECK-MACHO-DAG: __ZTVN2ns11PolymorphicE
+
+// CHECK-DEF: EXPORTS
+// CHECK-DEF-DAG:   ?function@ns@@YAXXZ{{$}}
+// CHECK-DEF-DAG:   ?variable@ns@@3HA DATA
+// CHECK-DEF-DAG:   ?method@Polymorphic@ns@@UEAAXXZ{{$}}
+// CHECK-DEF-DAG:   ??_7Polymorphic@ns@@6B@ DATA
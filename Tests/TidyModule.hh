@@ -0,0 +1,18 @@
+// REQUIRES: tidy
+// RUN: %clang_tidy -load=%idt_tidy -checks=-*,idt-* -config="{CheckOptions: {idt-unexported-public-interface.ExportMacro: IDT_TEST_ABI, idt-unexported-public-interface.IgnoredSymbols: ignored_function}}" %s -- -x c++ -std=c++17 2>&1 | %FileCheck %s
+
+// CHECK: TidyModule.hh:[[@LINE+1]]:1: warning: unexported public interface 'function' [idt-unexported-public-interface]
+void function();
+
+// CHECK-NOT: 'ignored_function'
+void ignored_function();
+
+// CHECK: TidyModule.hh:[[@LINE+1]]:8: warning: unexported public interface 'variable' [idt-unexported-public-interface]
+extern int variable;
+
+// CHECK: TidyModule.hh:[[@LINE+1]]:7: warning: unexported public interface 'Class' [idt-unexported-public-interface]
+class Class {
+  virtual void method();
+};
+
+inline void inline_function() {}
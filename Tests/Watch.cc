@@ -0,0 +1,9 @@
+// RUN: not %idt -export-macro IDT_TEST_ABI -watch -apply-fixits %s -- -I%S/include 2>&1 | %FileCheck %s
+// RUN: not %idt -export-macro IDT_TEST_ABI -watch -configuration=-DIDT_WATCH_A -configuration=-DIDT_WATCH_B %s -- -I%S/include 2>&1 | %FileCheck %s
+
+// The sources are analyzed again as the files change, which applying the
+// suggested changes would cause, so the run is refused before it starts.
+#include "GlobalHeader.h"
+
+// CHECK: --watch cannot be used with --apply-fixits, --capture, --incremental, --replay or several configurations
+// CHECK-NOT: remark: unexported public interface
@@ -0,0 +1,7 @@
+namespace ns {
+template <typename T>
+struct Box {
+  T value;
+  T get() const { return value; }
+};
+}
@@ -0,0 +1,5 @@
+#include "Box.h"
+
+int client() {
+  return ns::Box<int>{2}.get();
+}
@@ -0,0 +1,9 @@
+#include "GlobalHeader.h"
+
+#if defined(IDT_CONFIGURATION_A)
+void configuration_a_function();
+#else
+void configuration_b_function();
+#endif
+
+void common_function();
@@ -0,0 +1,6 @@
+#include "ClientUsage.hh"
+
+int client() {
+  ns::Gadget gadget;
+  return ns::used(gadget.size()) + ns::wrapper();
+}
@@ -0,0 +1,7 @@
+struct Sprocket {
+  virtual ~Sprocket() {}
+  virtual void turn() {}
+  void resize(int) {}
+};
+
+inline void make_sprocket() {}
@@ -0,0 +1,7 @@
+struct Widget {
+  virtual ~Widget();
+  virtual void draw();
+  void resize(int);
+};
+
+void make_widget();
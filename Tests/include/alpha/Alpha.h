@@ -0,0 +1,3 @@
+#include "GlobalHeader.h"
+
+void alpha_function();
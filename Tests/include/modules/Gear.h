@@ -0,0 +1,5 @@
+struct Gear {
+  void turn();
+};
+
+int gear_count();